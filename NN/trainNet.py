@@ -1,5 +1,8 @@
 # Train evaluation nets for GuiNN Checkers
 # example usage : python trainNet.py CheckersEarly CheckersMid CheckersEnd CheckersLateEnd
+# shared first layer nets : python trainNet.py --shared CheckersShared
+#   trains one first layer for all game phases with per phase hidden layers, from CheckersSharedData/Labels/Phases/Struct,
+#   and saves CheckersSharedEarlyWeights.txt etc. (each net's file holds the shared first layer too)
 #
 # TODO : generalize to read a file that contains inputs & net structure
 
@@ -9,13 +12,15 @@ from tensorflow import keras
 import numpy as np
 import sys
 
-def saveWeightsText( fileName ):
+sharedPhaseNames = [ "Early", "Mid", "End", "LateEnd" ] # in eGamePhase order, the index stored in Phases.dat
+
+def saveWeightsText( fileName, layers ):
 	# save the weights as a text file
 	np.set_printoptions(suppress=True)
 	np.set_printoptions(threshold=np.inf)
 	f = open(fileName, "w+") 
 	layerIdx = 0;
-	for layer in model.layers:
+	for layer in layers:
 		weights = layer.get_weights()
 		f.write("\n\n========Layer " + str(layerIdx) + "========\n")
 
@@ -25,6 +30,59 @@ def saveWeightsText( fileName ):
 		layerIdx = layerIdx + 1
 	f.close()
 
+def trainSharedNets( netName ):
+        dataFilename = netName + "Data.dat"
+        labelFilename = netName + "Labels.dat"
+        phaseFilename = netName + "Phases.dat"
+        structureFilename = netName + "Struct.txt"
+
+        epochsParam = 30 
+        batchSizeParam = 15000
+
+        netStructure = np.loadtxt( structureFilename );
+        numInputs = int(netStructure[0])
+        layerSizes = netStructure[2:6]
+        print("numInputs : " + str(numInputs) + " shared first layer : " + str(layerSizes[0]) )
+
+        positionData = np.fromfile(dataFilename, dtype=np.int8).reshape(-1, numInputs)
+        positionLabels = np.fromfile(labelFilename, dtype=np.float32)
+        positionPhases = np.fromfile(phaseFilename, dtype=np.uint8)
+        phaseMask = np.eye(len(sharedPhaseNames), dtype=np.float32)[positionPhases]
+        print ("dataLen:", format(len(positionData), ",") )
+
+        # One first layer feeds the hidden layers of every phase, the phase mask picks the output of the position's phase
+        inputs = keras.Input(shape=(numInputs,))
+        mask = keras.Input(shape=(len(sharedPhaseNames),))
+        sharedLayer = keras.layers.Dense(layerSizes[0], activation="relu")
+        shared = sharedLayer(inputs)
+        phaseLayers = []
+        phaseOutputs = []
+        for phaseName in sharedPhaseNames:
+                layers = [ keras.layers.Dense(layerSizes[1], activation="relu"),
+                           keras.layers.Dense(layerSizes[2], activation="relu"),
+                           keras.layers.Dense(layerSizes[3], activation="sigmoid") ]
+                x = shared
+                for layer in layers:
+                        x = layer(x)
+                phaseLayers.append(layers)
+                phaseOutputs.append(x)
+        output = keras.layers.Dot(axes=1)([keras.layers.Concatenate()(phaseOutputs), mask])
+        sharedModel = keras.Model(inputs=[inputs, mask], outputs=output)
+
+        lr_schedule = keras.optimizers.schedules.ExponentialDecay(initial_learning_rate=.01,decay_steps=5000,decay_rate=0.96)
+        sharedModel.compile(optimizer=keras.optimizers.Adam( learning_rate = lr_schedule ), loss="mean_squared_error")
+        sharedModel.fit([positionData, phaseMask], positionLabels, batch_size= batchSizeParam, epochs= epochsParam )
+
+        for phaseIdx in range(0, len(sharedPhaseNames)):
+                weightFilename = netName + sharedPhaseNames[phaseIdx] + "Weights.txt"
+                saveWeightsText( weightFilename, [sharedLayer] + phaseLayers[phaseIdx] )
+                print ("Saved " + weightFilename)
+
+if len(sys.argv) > 2 and sys.argv[1] == "--shared":
+        for argNum in range(2, len(sys.argv) ):
+                trainSharedNets( sys.argv[argNum] )
+        sys.exit()
+
 # compute all the neural nets requested
 for argNum in range(1, len(sys.argv) ):
 
@@ -84,7 +142,7 @@ for argNum in range(1, len(sys.argv) ):
 
         # Save the trained weights
         weightFilename =  netName + "Weights.txt";
-        saveWeightsText( weightFilename )
+        saveWeightsText( weightFilename, model.layers )
         
         print ("Saved " + weightFilename)
         print ("------------------------------")
@@ -0,0 +1,724 @@
+//
+// Neural net hidden layers with the layer sizes known at compile time
+// by Jonathan Kreuzer
+//
+// FixedNetwork<kFirstLayer, kHidden1, kHidden2> sums first layer values -> kHidden1 (RELU) -> kHidden2 (RELU) -> 1,
+// the same as NeuralNetwork::SumHiddenLayers and with the same results. The loop bounds are constants and each pass of a layer
+// sums 32 outputs (2 blocks of the blocked weights) in named registers, so a 32 wide layer stays in registers for the whole layer,
+// and there's one call per eval instead of a few kernel calls per layer.
+// After the RELU most of the first layer values are 0, so the first hidden layer can also be summed sparsely :
+// the nonzero input pairs are listed first and only their weights are multiplied in (see NonzeroPairs).
+// SumHiddenLayersBatch sums kEvalBatchSize positions together, so each weight load is shared by all of them.
+// It uses the weights of a NeuralNetwork that was built with that structure (see FixedNetwork::Matches).
+// The runtime sized NeuralNetwork path is still used for any other structure, and for the int8 hidden layer.
+//
+#pragma once
+
+#include "NeuralNet.h"
+
+const int kFixedPassOutputs = 2 * kTransformBlockOutputs;
+static_assert(kEvalBatchSize == 4, "the batch layers have the sums of 4 positions in registers");
+static_assert(2 * kTransformBlockOutputs == 32, "the nonzero pair offsets are shifted by 5");
+
+// The input pairs of a layer that aren't both 0, as their values and the offsets of their weights in a block.
+// The count is padded with 0 pairs to a multiple of 4 so the layers can do a few pairs per step without a remainder loop.
+template<int kInputs>
+struct NonzeroPairs
+{
+	alignas(64) int32_t values[kInputs / 2 + 16];
+	alignas(64) int32_t offsets[kInputs / 2 + 16];
+	int count;
+
+	void Pad()
+	{
+		for (int i = 0; i < 4; i++) { values[count + i] = 0; offsets[count + i] = 0; }
+		count = (count + 3) & ~3;
+	}
+};
+
+// For each 8-bit mask, the positions of its set bits in order and how many there are, to pack the nonzero pairs together without branches
+struct NonzeroPairLookup
+{
+	alignas(64) uint8_t indices[256][8];
+	uint8_t count[256];
+	NonzeroPairLookup();
+};
+extern const NonzeroPairLookup g_NonzeroPairLookup;
+
+// -------------------
+// Plain C++ for the scalar level
+// -------------------
+namespace FixedScalar
+{
+	template<int kInputs>
+	inline void Clamp0(const int16_t* values, int16_t* outputs)
+	{
+		for (int i = 0; i < kInputs; i++) { outputs[i] = std::max(values[i], (int16_t)0); }
+	}
+
+	template<int kInputs, int kOutputs>
+	inline void ReluLayer(const NetworkTransform<nnInt_t>& transform, const int16_t* inputs, int16_t* outputs)
+	{
+		int32_t sums[kOutputs];
+		memcpy(sums, transform.biases32, sizeof(sums));
+
+		const int16_t* weights = transform.BlockedWeights;
+		for (int block = 0; block < kOutputs; block += kTransformBlockOutputs)
+		{
+			for (int i = 0; i < kInputs; i += 2, weights += 2 * kTransformBlockOutputs)
+			{
+				for (int j = 0; j < kTransformBlockOutputs; j++) {
+					sums[block + j] += weights[2 * j] * inputs[i] + weights[2 * j + 1] * inputs[i + 1];
+				}
+			}
+		}
+		for (int o = 0; o < kOutputs; o++) { outputs[o] = (int16_t)std::min(std::max(sums[o] >> kFixedShift, 0), 32767); }
+	}
+
+	template<int kInputs>
+	inline int OutputLayer(const NetworkTransform<nnInt_t>& transform, const int16_t* inputs)
+	{
+		const int16_t* weights = &transform.Weights[transform.weightStart];
+		int32_t sum = transform.biases32[0];
+		for (int i = 0; i < kInputs; i++) { sum += weights[i] * inputs[i]; }
+		return ClampInt(sum >> kFixedShift, -kFixedMax, kFixedMax);
+	}
+}
+
+// -------------------
+// SSE2 : a pass of 32 outputs is 8 registers
+// -------------------
+namespace FixedSse2
+{
+	template<int kInputs>
+	inline void Clamp0(const int16_t* values, int16_t* outputs)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		for (int i = 0; i < kInputs; i += 8) {
+			_mm_store_si128((__m128i*)(outputs + i), _mm_max_epi16(_mm_loadu_si128((const __m128i*)(values + i)), zero));
+		}
+	}
+
+	// add the biases, shift, pack to 16-bit and clamp to >= 0, for 8 outputs
+	inline void StoreRelu(__m128i sumLo, __m128i sumHi, const int32_t* biases, int16_t* outputs)
+	{
+		const __m128i lo = _mm_srai_epi32(_mm_add_epi32(sumLo, _mm_loadu_si128((const __m128i*)biases)), kFixedShift);
+		const __m128i hi = _mm_srai_epi32(_mm_add_epi32(sumHi, _mm_loadu_si128((const __m128i*)(biases + 4))), kFixedShift);
+		_mm_store_si128((__m128i*)outputs, _mm_max_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128()));
+	}
+
+	template<int kInputs, int kOutputs>
+	inline void ReluLayer(const NetworkTransform<nnInt_t>& transform, const int16_t* inputs, int16_t* outputs)
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+		const int32_t* inputPairs = (const int32_t*)inputs;
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* w0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* w1 = w0 + kBlockWeights;
+			__m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0, s4 = s0, s5 = s0, s6 = s0, s7 = s0;
+			for (int p = 0; p < kInputs / 2; p++, w0 += 2 * kTransformBlockOutputs, w1 += 2 * kTransformBlockOutputs)
+			{
+				const __m128i in = _mm_set1_epi32(inputPairs[p]);
+				s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w0 + 0)), in));
+				s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w0 + 8)), in));
+				s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w0 + 16)), in));
+				s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w0 + 24)), in));
+				s4 = _mm_add_epi32(s4, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w1 + 0)), in));
+				s5 = _mm_add_epi32(s5, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w1 + 8)), in));
+				s6 = _mm_add_epi32(s6, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w1 + 16)), in));
+				s7 = _mm_add_epi32(s7, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w1 + 24)), in));
+			}
+			StoreRelu(s0, s1, transform.biases32 + pass, outputs + pass);
+			StoreRelu(s2, s3, transform.biases32 + pass + 8, outputs + pass + 8);
+			StoreRelu(s4, s5, transform.biases32 + pass + 16, outputs + pass + 16);
+			StoreRelu(s6, s7, transform.biases32 + pass + 24, outputs + pass + 24);
+		}
+	}
+
+	// Clamps the first layer values to >= 0 (the RELU) and lists the nonzero pairs
+	template<int kInputs>
+	inline void FindNonzeroPairs(const int16_t* values, NonzeroPairs<kInputs>& pairs)
+	{
+		alignas(16) int32_t activated[4];
+		int count = 0;
+		for (int i = 0; i < kInputs; i += 8)
+		{
+			const __m128i pairValues = _mm_max_epi16(_mm_loadu_si128((const __m128i*)(values + i)), _mm_setzero_si128());
+			const uint32_t nonzero = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(pairValues, _mm_setzero_si128()))) & 0xF;
+			const uint8_t* indices = g_NonzeroPairLookup.indices[nonzero];
+			_mm_store_si128((__m128i*)activated, pairValues);
+			for (int j = 0; j < 4; j++)
+			{
+				pairs.values[count + j] = activated[indices[j]];
+				pairs.offsets[count + j] = (i / 2 + indices[j]) * 2 * kTransformBlockOutputs;
+			}
+			count += g_NonzeroPairLookup.count[nonzero];
+		}
+		pairs.count = count;
+		pairs.Pad();
+	}
+
+	template<int kInputs, int kOutputs>
+	inline void SparseReluLayer(const NetworkTransform<nnInt_t>& transform, const NonzeroPairs<kInputs>& pairs, int16_t* outputs)
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* block0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* block1 = block0 + kBlockWeights;
+			__m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0, s4 = s0, s5 = s0, s6 = s0, s7 = s0;
+			for (int k = 0; k < pairs.count; k++)
+			{
+				const __m128i in = _mm_set1_epi32(pairs.values[k]);
+				const int16_t* w0 = block0 + pairs.offsets[k];
+				const int16_t* w1 = block1 + pairs.offsets[k];
+				s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w0 + 0)), in));
+				s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w0 + 8)), in));
+				s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w0 + 16)), in));
+				s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w0 + 24)), in));
+				s4 = _mm_add_epi32(s4, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w1 + 0)), in));
+				s5 = _mm_add_epi32(s5, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w1 + 8)), in));
+				s6 = _mm_add_epi32(s6, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w1 + 16)), in));
+				s7 = _mm_add_epi32(s7, _mm_madd_epi16(_mm_load_si128((const __m128i*)(w1 + 24)), in));
+			}
+			StoreRelu(s0, s1, transform.biases32 + pass, outputs + pass);
+			StoreRelu(s2, s3, transform.biases32 + pass + 8, outputs + pass + 8);
+			StoreRelu(s4, s5, transform.biases32 + pass + 16, outputs + pass + 16);
+			StoreRelu(s6, s7, transform.biases32 + pass + 24, outputs + pass + 24);
+		}
+	}
+
+	template<int kInputs>
+	inline int OutputLayer(const NetworkTransform<nnInt_t>& transform, const int16_t* inputs)
+	{
+		const int16_t* weights = &transform.Weights[transform.weightStart];
+		__m128i sum = _mm_setzero_si128();
+		for (int i = 0; i < kInputs; i += 8) {
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_load_si128((const __m128i*)(weights + i)), _mm_load_si128((const __m128i*)(inputs + i))));
+		}
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return ClampInt((transform.biases32[0] + _mm_cvtsi128_si32(sum)) >> kFixedShift, -kFixedMax, kFixedMax);
+	}
+}
+
+// -------------------
+// AVX2 : a pass of 32 outputs is 4 registers
+// -------------------
+namespace FixedAvx2
+{
+	SIMD_TARGET("avx2") inline int32_t horizontalSum_8x32(__m256i v)
+	{
+		__m128i hSum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		hSum = _mm_add_epi32(hSum, _mm_shuffle_epi32(hSum, _MM_SHUFFLE(1, 0, 3, 2)));
+		hSum = _mm_add_epi32(hSum, _mm_shuffle_epi32(hSum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(hSum);
+	}
+
+	template<int kInputs>
+	SIMD_TARGET("avx2") inline void Clamp0(const int16_t* values, int16_t* outputs)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		for (int i = 0; i < kInputs; i += 16) {
+			_mm256_store_si256((__m256i*)(outputs + i), _mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(values + i)), zero));
+		}
+	}
+
+	// add the biases, shift, pack to 16-bit and clamp to >= 0, for a block of 16 outputs
+	SIMD_TARGET("avx2") inline void StoreReluBlock(__m256i sumLo, __m256i sumHi, const int32_t* biases, int16_t* outputs)
+	{
+		const __m256i lo = _mm256_srai_epi32(_mm256_add_epi32(sumLo, _mm256_loadu_si256((const __m256i*)biases)), kFixedShift);
+		const __m256i hi = _mm256_srai_epi32(_mm256_add_epi32(sumHi, _mm256_loadu_si256((const __m256i*)(biases + 8))), kFixedShift);
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+		_mm256_store_si256((__m256i*)outputs, _mm256_max_epi16(packed, _mm256_setzero_si256()));
+	}
+
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET("avx2") inline void ReluLayer(const NetworkTransform<nnInt_t>& transform, const int16_t* inputs, int16_t* outputs)
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+		const int32_t* inputPairs = (const int32_t*)inputs;
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* w0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* w1 = w0 + kBlockWeights;
+			__m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+			for (int p = 0; p < kInputs / 2; p++, w0 += 2 * kTransformBlockOutputs, w1 += 2 * kTransformBlockOutputs)
+			{
+				const __m256i in = _mm256_set1_epi32(inputPairs[p]);
+				s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(w0 + 0)), in));
+				s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(w0 + 16)), in));
+				s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(w1 + 0)), in));
+				s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(w1 + 16)), in));
+			}
+			StoreReluBlock(s0, s1, transform.biases32 + pass, outputs + pass);
+			StoreReluBlock(s2, s3, transform.biases32 + pass + 16, outputs + pass + 16);
+		}
+	}
+
+	// Clamps the first layer values to >= 0 (the RELU) and lists the nonzero pairs, 8 pairs at a time packed together with vpermd and the lookup table
+	template<int kInputs>
+	SIMD_TARGET("avx2") inline void FindNonzeroPairs(const int16_t* values, NonzeroPairs<kInputs>& pairs)
+	{
+		int count = 0;
+		for (int i = 0; i < kInputs; i += 16)
+		{
+			const __m256i pairValues = _mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(values + i)), _mm256_setzero_si256());
+			const uint32_t nonzero = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(pairValues, _mm256_setzero_si256()))) & 0xFF;
+			const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)g_NonzeroPairLookup.indices[nonzero]));
+			const __m256i offsets = _mm256_slli_epi32(_mm256_add_epi32(indices, _mm256_set1_epi32(i / 2)), 5); // * 2 * kTransformBlockOutputs
+			_mm256_storeu_si256((__m256i*)(pairs.values + count), _mm256_permutevar8x32_epi32(pairValues, indices));
+			_mm256_storeu_si256((__m256i*)(pairs.offsets + count), offsets);
+			count += g_NonzeroPairLookup.count[nonzero];
+		}
+		pairs.count = count;
+		pairs.Pad();
+	}
+
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET("avx2") inline void SparseReluLayer(const NetworkTransform<nnInt_t>& transform, const NonzeroPairs<kInputs>& pairs, int16_t* outputs)
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* block0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* block1 = block0 + kBlockWeights;
+			__m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+			for (int k = 0; k < pairs.count; k++)
+			{
+				const __m256i in = _mm256_set1_epi32(pairs.values[k]);
+				const int16_t* w0 = block0 + pairs.offsets[k];
+				const int16_t* w1 = block1 + pairs.offsets[k];
+				s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(w0 + 0)), in));
+				s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(w0 + 16)), in));
+				s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(w1 + 0)), in));
+				s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(w1 + 16)), in));
+			}
+			StoreReluBlock(s0, s1, transform.biases32 + pass, outputs + pass);
+			StoreReluBlock(s2, s3, transform.biases32 + pass + 16, outputs + pass + 16);
+		}
+	}
+
+	// A block of 16 outputs at a time for 2 positions at a time (4 positions would need more than the 16 registers)
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET("avx2") inline void ReluLayerBatch(const NetworkTransform<nnInt_t>& transform, const int16_t inputs[][kInputs], int16_t outputs[][kOutputs])
+	{
+		for (int pos = 0; pos < kEvalBatchSize; pos += 2)
+		{
+			const int32_t* in0 = (const int32_t*)inputs[pos];
+			const int32_t* in1 = (const int32_t*)inputs[pos + 1];
+			const int16_t* weights = transform.BlockedWeights;
+			for (int block = 0; block < kOutputs; block += kTransformBlockOutputs)
+			{
+				__m256i a0 = _mm256_setzero_si256(), a1 = a0, b0 = a0, b1 = a0;
+				for (int p = 0; p < kInputs / 2; p++, weights += 2 * kTransformBlockOutputs)
+				{
+					const __m256i wLo = _mm256_load_si256((const __m256i*)weights);
+					const __m256i wHi = _mm256_load_si256((const __m256i*)(weights + 16));
+					const __m256i inA = _mm256_set1_epi32(in0[p]);
+					const __m256i inB = _mm256_set1_epi32(in1[p]);
+					a0 = _mm256_add_epi32(a0, _mm256_madd_epi16(wLo, inA));
+					a1 = _mm256_add_epi32(a1, _mm256_madd_epi16(wHi, inA));
+					b0 = _mm256_add_epi32(b0, _mm256_madd_epi16(wLo, inB));
+					b1 = _mm256_add_epi32(b1, _mm256_madd_epi16(wHi, inB));
+				}
+				StoreReluBlock(a0, a1, transform.biases32 + block, outputs[pos] + block);
+				StoreReluBlock(b0, b1, transform.biases32 + block, outputs[pos + 1] + block);
+			}
+		}
+	}
+
+	template<int kInputs>
+	SIMD_TARGET("avx2") inline int OutputLayer(const NetworkTransform<nnInt_t>& transform, const int16_t* inputs)
+	{
+		const int16_t* weights = &transform.Weights[transform.weightStart];
+		__m256i sum = _mm256_setzero_si256();
+		for (int i = 0; i < kInputs; i += 16) {
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(weights + i)), _mm256_load_si256((const __m256i*)(inputs + i))));
+		}
+		return ClampInt((transform.biases32[0] + horizontalSum_8x32(sum)) >> kFixedShift, -kFixedMax, kFixedMax);
+	}
+}
+
+// -------------------
+// AVX-512 : a block of 16 outputs is 1 register, and each block has 2 sums (even and odd input pairs) so the adds don't wait on each other.
+// With VNNI the multiply and the add is one vpdpwssd, which has a few cycles of latency, so each block has 4 sums.
+// (kInputs / 2 is a multiple of 4 for every layer, see the FixedNetwork static_asserts)
+// -------------------
+namespace FixedAvx512
+{
+	// add the biases, shift, saturate to 16-bit and clamp to >= 0
+	SIMD_TARGET(AVX512_TARGET) inline void StoreReluBlock(__m512i sum, const int32_t* biases, int16_t* outputs)
+	{
+		const __m512i shifted = _mm512_srai_epi32(_mm512_add_epi32(sum, _mm512_loadu_si512((const void*)biases)), kFixedShift);
+		_mm256_store_si256((__m256i*)outputs, _mm256_max_epi16(_mm512_cvtsepi32_epi16(shifted), _mm256_setzero_si256()));
+	}
+
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET(AVX512_TARGET) inline void ReluLayer(const NetworkTransform<nnInt_t>& transform, const int16_t* inputs, int16_t* outputs)
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+		const int32_t* inputPairs = (const int32_t*)inputs;
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* w0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* w1 = w0 + kBlockWeights;
+			__m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0;
+			for (int p = 0; p < kInputs / 2; p += 2, w0 += 4 * kTransformBlockOutputs, w1 += 4 * kTransformBlockOutputs)
+			{
+				const __m512i in0 = _mm512_set1_epi32(inputPairs[p]);
+				const __m512i in1 = _mm512_set1_epi32(inputPairs[p + 1]);
+				s0 = _mm512_add_epi32(s0, _mm512_madd_epi16(_mm512_load_si512((const void*)(w0 + 0)), in0));
+				s1 = _mm512_add_epi32(s1, _mm512_madd_epi16(_mm512_load_si512((const void*)(w0 + 32)), in1));
+				s2 = _mm512_add_epi32(s2, _mm512_madd_epi16(_mm512_load_si512((const void*)(w1 + 0)), in0));
+				s3 = _mm512_add_epi32(s3, _mm512_madd_epi16(_mm512_load_si512((const void*)(w1 + 32)), in1));
+			}
+			StoreReluBlock(_mm512_add_epi32(s0, s1), transform.biases32 + pass, outputs + pass);
+			StoreReluBlock(_mm512_add_epi32(s2, s3), transform.biases32 + pass + 16, outputs + pass + 16);
+		}
+	}
+
+	// Clamps the first layer values to >= 0 (the RELU) and lists the nonzero pairs, 16 pairs at a time packed together by vpcompressd
+	template<int kInputs>
+	SIMD_TARGET(AVX512_TARGET) inline void FindNonzeroPairs(const int16_t* values, NonzeroPairs<kInputs>& pairs)
+	{
+		const __m512i offsetStep = _mm512_set1_epi32(16 * 2 * kTransformBlockOutputs);
+		__m512i offsets = _mm512_slli_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), 5); // * 2 * kTransformBlockOutputs
+		int count = 0;
+		for (int i = 0; i < kInputs; i += 32)
+		{
+			const __m512i pairValues = _mm512_max_epi16(_mm512_loadu_si512((const void*)(values + i)), _mm512_setzero_si512());
+			const __mmask16 nonzero = _mm512_test_epi32_mask(pairValues, pairValues);
+			_mm512_storeu_si512((void*)(pairs.values + count), _mm512_maskz_compress_epi32(nonzero, pairValues));
+			_mm512_storeu_si512((void*)(pairs.offsets + count), _mm512_maskz_compress_epi32(nonzero, offsets));
+			count += g_NonzeroPairLookup.count[nonzero & 0xFF] + g_NonzeroPairLookup.count[nonzero >> 8];
+			offsets = _mm512_add_epi32(offsets, offsetStep);
+		}
+		pairs.count = count;
+		pairs.Pad();
+	}
+
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET(AVX512_TARGET) inline void SparseReluLayer(const NetworkTransform<nnInt_t>& transform, const NonzeroPairs<kInputs>& pairs, int16_t* outputs)
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* block0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* block1 = block0 + kBlockWeights;
+			__m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0;
+			for (int k = 0; k < pairs.count; k += 2)
+			{
+				const __m512i in0 = _mm512_set1_epi32(pairs.values[k]);
+				const __m512i in1 = _mm512_set1_epi32(pairs.values[k + 1]);
+				s0 = _mm512_add_epi32(s0, _mm512_madd_epi16(_mm512_load_si512((const void*)(block0 + pairs.offsets[k])), in0));
+				s1 = _mm512_add_epi32(s1, _mm512_madd_epi16(_mm512_load_si512((const void*)(block0 + pairs.offsets[k + 1])), in1));
+				s2 = _mm512_add_epi32(s2, _mm512_madd_epi16(_mm512_load_si512((const void*)(block1 + pairs.offsets[k])), in0));
+				s3 = _mm512_add_epi32(s3, _mm512_madd_epi16(_mm512_load_si512((const void*)(block1 + pairs.offsets[k + 1])), in1));
+			}
+			StoreReluBlock(_mm512_add_epi32(s0, s1), transform.biases32 + pass, outputs + pass);
+			StoreReluBlock(_mm512_add_epi32(s2, s3), transform.biases32 + pass + 16, outputs + pass + 16);
+		}
+	}
+
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET(VNNI_TARGET) inline void ReluLayerVnni(const NetworkTransform<nnInt_t>& transform, const int16_t* inputs, int16_t* outputs)
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+		const int32_t* inputPairs = (const int32_t*)inputs;
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* w0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* w1 = w0 + kBlockWeights;
+			__m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0, s4 = s0, s5 = s0, s6 = s0, s7 = s0;
+			for (int p = 0; p < kInputs / 2; p += 4, w0 += 8 * kTransformBlockOutputs, w1 += 8 * kTransformBlockOutputs)
+			{
+				const __m512i in0 = _mm512_set1_epi32(inputPairs[p]);
+				const __m512i in1 = _mm512_set1_epi32(inputPairs[p + 1]);
+				const __m512i in2 = _mm512_set1_epi32(inputPairs[p + 2]);
+				const __m512i in3 = _mm512_set1_epi32(inputPairs[p + 3]);
+				s0 = _mm512_dpwssd_epi32(s0, in0, _mm512_load_si512((const void*)(w0 + 0)));
+				s1 = _mm512_dpwssd_epi32(s1, in1, _mm512_load_si512((const void*)(w0 + 32)));
+				s2 = _mm512_dpwssd_epi32(s2, in2, _mm512_load_si512((const void*)(w0 + 64)));
+				s3 = _mm512_dpwssd_epi32(s3, in3, _mm512_load_si512((const void*)(w0 + 96)));
+				s4 = _mm512_dpwssd_epi32(s4, in0, _mm512_load_si512((const void*)(w1 + 0)));
+				s5 = _mm512_dpwssd_epi32(s5, in1, _mm512_load_si512((const void*)(w1 + 32)));
+				s6 = _mm512_dpwssd_epi32(s6, in2, _mm512_load_si512((const void*)(w1 + 64)));
+				s7 = _mm512_dpwssd_epi32(s7, in3, _mm512_load_si512((const void*)(w1 + 96)));
+			}
+			StoreReluBlock(_mm512_add_epi32(_mm512_add_epi32(s0, s1), _mm512_add_epi32(s2, s3)), transform.biases32 + pass, outputs + pass);
+			StoreReluBlock(_mm512_add_epi32(_mm512_add_epi32(s4, s5), _mm512_add_epi32(s6, s7)), transform.biases32 + pass + 16, outputs + pass + 16);
+		}
+	}
+
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET(VNNI_TARGET) inline void SparseReluLayerVnni(const NetworkTransform<nnInt_t>& transform, const NonzeroPairs<kInputs>& pairs, int16_t* outputs)
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* block0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* block1 = block0 + kBlockWeights;
+			__m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0, s4 = s0, s5 = s0, s6 = s0, s7 = s0;
+			for (int k = 0; k < pairs.count; k += 4)
+			{
+				const __m512i in0 = _mm512_set1_epi32(pairs.values[k]);
+				const __m512i in1 = _mm512_set1_epi32(pairs.values[k + 1]);
+				const __m512i in2 = _mm512_set1_epi32(pairs.values[k + 2]);
+				const __m512i in3 = _mm512_set1_epi32(pairs.values[k + 3]);
+				s0 = _mm512_dpwssd_epi32(s0, in0, _mm512_load_si512((const void*)(block0 + pairs.offsets[k])));
+				s1 = _mm512_dpwssd_epi32(s1, in1, _mm512_load_si512((const void*)(block0 + pairs.offsets[k + 1])));
+				s2 = _mm512_dpwssd_epi32(s2, in2, _mm512_load_si512((const void*)(block0 + pairs.offsets[k + 2])));
+				s3 = _mm512_dpwssd_epi32(s3, in3, _mm512_load_si512((const void*)(block0 + pairs.offsets[k + 3])));
+				s4 = _mm512_dpwssd_epi32(s4, in0, _mm512_load_si512((const void*)(block1 + pairs.offsets[k])));
+				s5 = _mm512_dpwssd_epi32(s5, in1, _mm512_load_si512((const void*)(block1 + pairs.offsets[k + 1])));
+				s6 = _mm512_dpwssd_epi32(s6, in2, _mm512_load_si512((const void*)(block1 + pairs.offsets[k + 2])));
+				s7 = _mm512_dpwssd_epi32(s7, in3, _mm512_load_si512((const void*)(block1 + pairs.offsets[k + 3])));
+			}
+			StoreReluBlock(_mm512_add_epi32(_mm512_add_epi32(s0, s1), _mm512_add_epi32(s2, s3)), transform.biases32 + pass, outputs + pass);
+			StoreReluBlock(_mm512_add_epi32(_mm512_add_epi32(s4, s5), _mm512_add_epi32(s6, s7)), transform.biases32 + pass + 16, outputs + pass + 16);
+		}
+	}
+
+	// A pass of 32 outputs at a time for each of the 4 positions
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET(AVX512_TARGET) inline void ReluLayerBatch(const NetworkTransform<nnInt_t>& transform, const int16_t inputs[][kInputs], int16_t outputs[][kOutputs])
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+		const int32_t* in0 = (const int32_t*)inputs[0];
+		const int32_t* in1 = (const int32_t*)inputs[1];
+		const int32_t* in2 = (const int32_t*)inputs[2];
+		const int32_t* in3 = (const int32_t*)inputs[3];
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* w0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* w1 = w0 + kBlockWeights;
+			__m512i a0 = _mm512_setzero_si512(), a1 = a0, b0 = a0, b1 = a0, c0 = a0, c1 = a0, d0 = a0, d1 = a0;
+			for (int p = 0; p < kInputs / 2; p++, w0 += 2 * kTransformBlockOutputs, w1 += 2 * kTransformBlockOutputs)
+			{
+				const __m512i weights0 = _mm512_load_si512((const void*)w0);
+				const __m512i weights1 = _mm512_load_si512((const void*)w1);
+				__m512i in = _mm512_set1_epi32(in0[p]);
+				a0 = _mm512_add_epi32(a0, _mm512_madd_epi16(weights0, in));
+				a1 = _mm512_add_epi32(a1, _mm512_madd_epi16(weights1, in));
+				in = _mm512_set1_epi32(in1[p]);
+				b0 = _mm512_add_epi32(b0, _mm512_madd_epi16(weights0, in));
+				b1 = _mm512_add_epi32(b1, _mm512_madd_epi16(weights1, in));
+				in = _mm512_set1_epi32(in2[p]);
+				c0 = _mm512_add_epi32(c0, _mm512_madd_epi16(weights0, in));
+				c1 = _mm512_add_epi32(c1, _mm512_madd_epi16(weights1, in));
+				in = _mm512_set1_epi32(in3[p]);
+				d0 = _mm512_add_epi32(d0, _mm512_madd_epi16(weights0, in));
+				d1 = _mm512_add_epi32(d1, _mm512_madd_epi16(weights1, in));
+			}
+			StoreReluBlock(a0, transform.biases32 + pass, outputs[0] + pass);
+			StoreReluBlock(a1, transform.biases32 + pass + 16, outputs[0] + pass + 16);
+			StoreReluBlock(b0, transform.biases32 + pass, outputs[1] + pass);
+			StoreReluBlock(b1, transform.biases32 + pass + 16, outputs[1] + pass + 16);
+			StoreReluBlock(c0, transform.biases32 + pass, outputs[2] + pass);
+			StoreReluBlock(c1, transform.biases32 + pass + 16, outputs[2] + pass + 16);
+			StoreReluBlock(d0, transform.biases32 + pass, outputs[3] + pass);
+			StoreReluBlock(d1, transform.biases32 + pass + 16, outputs[3] + pass + 16);
+		}
+	}
+
+	template<int kInputs, int kOutputs>
+	SIMD_TARGET(VNNI_TARGET) inline void ReluLayerBatchVnni(const NetworkTransform<nnInt_t>& transform, const int16_t inputs[][kInputs], int16_t outputs[][kOutputs])
+	{
+		const int kBlockWeights = kInputs * kTransformBlockOutputs;
+		const int32_t* in0 = (const int32_t*)inputs[0];
+		const int32_t* in1 = (const int32_t*)inputs[1];
+		const int32_t* in2 = (const int32_t*)inputs[2];
+		const int32_t* in3 = (const int32_t*)inputs[3];
+
+		for (int pass = 0; pass < kOutputs; pass += kFixedPassOutputs)
+		{
+			const int16_t* w0 = transform.BlockedWeights + (pass / kTransformBlockOutputs) * kBlockWeights;
+			const int16_t* w1 = w0 + kBlockWeights;
+			__m512i a0 = _mm512_setzero_si512(), a1 = a0, b0 = a0, b1 = a0, c0 = a0, c1 = a0, d0 = a0, d1 = a0;
+			for (int p = 0; p < kInputs / 2; p++, w0 += 2 * kTransformBlockOutputs, w1 += 2 * kTransformBlockOutputs)
+			{
+				const __m512i weights0 = _mm512_load_si512((const void*)w0);
+				const __m512i weights1 = _mm512_load_si512((const void*)w1);
+				__m512i in = _mm512_set1_epi32(in0[p]);
+				a0 = _mm512_dpwssd_epi32(a0, in, weights0);
+				a1 = _mm512_dpwssd_epi32(a1, in, weights1);
+				in = _mm512_set1_epi32(in1[p]);
+				b0 = _mm512_dpwssd_epi32(b0, in, weights0);
+				b1 = _mm512_dpwssd_epi32(b1, in, weights1);
+				in = _mm512_set1_epi32(in2[p]);
+				c0 = _mm512_dpwssd_epi32(c0, in, weights0);
+				c1 = _mm512_dpwssd_epi32(c1, in, weights1);
+				in = _mm512_set1_epi32(in3[p]);
+				d0 = _mm512_dpwssd_epi32(d0, in, weights0);
+				d1 = _mm512_dpwssd_epi32(d1, in, weights1);
+			}
+			StoreReluBlock(a0, transform.biases32 + pass, outputs[0] + pass);
+			StoreReluBlock(a1, transform.biases32 + pass + 16, outputs[0] + pass + 16);
+			StoreReluBlock(b0, transform.biases32 + pass, outputs[1] + pass);
+			StoreReluBlock(b1, transform.biases32 + pass + 16, outputs[1] + pass + 16);
+			StoreReluBlock(c0, transform.biases32 + pass, outputs[2] + pass);
+			StoreReluBlock(c1, transform.biases32 + pass + 16, outputs[2] + pass + 16);
+			StoreReluBlock(d0, transform.biases32 + pass, outputs[3] + pass);
+			StoreReluBlock(d1, transform.biases32 + pass + 16, outputs[3] + pass + 16);
+		}
+	}
+}
+
+template<int kFirstLayer, int kHidden1, int kHidden2>
+class FixedNetwork
+{
+	static_assert(kFirstLayer % 32 == 0, "first layer outputs must be a multiple of 32");
+	static_assert(kHidden1 % kFixedPassOutputs == 0 && kHidden2 % kFixedPassOutputs == 0, "hidden layers must be whole passes of 32 outputs");
+
+public:
+	// Is the network built with this structure (and blocked weights for the hidden layers)?
+	static bool Matches(const NeuralNetwork<nnInt_t>& network)
+	{
+		return network.LayerCount() == 4
+			&& network.GetLayer(0)->outputCount == kFirstLayer
+			&& network.GetLayer(1)->outputCount == kHidden1 && network.GetLayer(1)->activationType == eActivation::RELU
+			&& network.GetLayer(2)->outputCount == kHidden2 && network.GetLayer(2)->activationType == eActivation::RELU
+			&& network.GetLayer(3)->outputCount == 1 && network.GetLayer(3)->activationType == eActivation::NONE
+			&& network.GetTransform(1)->BlockedWeights && network.GetTransform(2)->BlockedWeights;
+	}
+
+	// Same result as NeuralNetBase::GetSumIncremental, for the first layer values before the activation.
+	// bSparse sums only the nonzero activations into the first hidden layer.
+	static int SumHiddenLayers(const NeuralNetwork<nnInt_t>& network, const nnInt_t firstLayerValues[], bool bSparse)
+	{
+		switch (SIMD::KernelLevel())
+		{
+		case eSimdLevel::AVX512_VNNI: return bSparse ? SumVnni<true>(network, firstLayerValues) : SumVnni<false>(network, firstLayerValues);
+		case eSimdLevel::AVX512BW: return bSparse ? SumAvx512<true>(network, firstLayerValues) : SumAvx512<false>(network, firstLayerValues);
+		case eSimdLevel::AVX2: return bSparse ? SumAvx2<true>(network, firstLayerValues) : SumAvx2<false>(network, firstLayerValues);
+		case eSimdLevel::SSE2: return bSparse ? SumSse2<true>(network, firstLayerValues) : SumSse2<false>(network, firstLayerValues);
+		default: return SumScalar(network, firstLayerValues);
+		}
+	}
+
+	// kEvalBatchSize positions at once with the dense first hidden layer, for the first layer values before the activation
+	static void SumHiddenLayersBatch(const NeuralNetwork<nnInt_t>& network, const nnInt_t* const firstLayerValues[], int sums[])
+	{
+		switch (SIMD::KernelLevel())
+		{
+		case eSimdLevel::AVX512_VNNI: SumBatchVnni(network, firstLayerValues, sums); break;
+		case eSimdLevel::AVX512BW: SumBatchAvx512(network, firstLayerValues, sums); break;
+		case eSimdLevel::AVX2: SumBatchAvx2(network, firstLayerValues, sums); break;
+		default:
+			for (int b = 0; b < kEvalBatchSize; b++) { sums[b] = SumHiddenLayers(network, firstLayerValues[b], false); }
+			break;
+		}
+	}
+
+private:
+	static int SumScalar(const NeuralNetwork<nnInt_t>& network, const nnInt_t firstLayerValues[])
+	{
+		alignas(64) int16_t inputs[kFirstLayer], hidden1[kHidden1], hidden2[kHidden2];
+		FixedScalar::Clamp0<kFirstLayer>(firstLayerValues, inputs);
+		FixedScalar::ReluLayer<kFirstLayer, kHidden1>(*network.GetTransform(1), inputs, hidden1);
+		FixedScalar::ReluLayer<kHidden1, kHidden2>(*network.GetTransform(2), hidden1, hidden2);
+		return FixedScalar::OutputLayer<kHidden2>(*network.GetTransform(3), hidden2);
+	}
+
+	template<bool kSparse>
+	static int SumSse2(const NeuralNetwork<nnInt_t>& network, const nnInt_t firstLayerValues[])
+	{
+		alignas(64) int16_t inputs[kFirstLayer], hidden1[kHidden1], hidden2[kHidden2];
+		if (kSparse) {
+			NonzeroPairs<kFirstLayer> pairs;
+			FixedSse2::FindNonzeroPairs<kFirstLayer>(firstLayerValues, pairs);
+			FixedSse2::SparseReluLayer<kFirstLayer, kHidden1>(*network.GetTransform(1), pairs, hidden1);
+		} else {
+			FixedSse2::Clamp0<kFirstLayer>(firstLayerValues, inputs);
+			FixedSse2::ReluLayer<kFirstLayer, kHidden1>(*network.GetTransform(1), inputs, hidden1);
+		}
+		FixedSse2::ReluLayer<kHidden1, kHidden2>(*network.GetTransform(2), hidden1, hidden2);
+		return FixedSse2::OutputLayer<kHidden2>(*network.GetTransform(3), hidden2);
+	}
+
+	template<bool kSparse>
+	SIMD_TARGET("avx2") static int SumAvx2(const NeuralNetwork<nnInt_t>& network, const nnInt_t firstLayerValues[])
+	{
+		alignas(64) int16_t inputs[kFirstLayer], hidden1[kHidden1], hidden2[kHidden2];
+		if (kSparse) {
+			NonzeroPairs<kFirstLayer> pairs;
+			FixedAvx2::FindNonzeroPairs<kFirstLayer>(firstLayerValues, pairs);
+			FixedAvx2::SparseReluLayer<kFirstLayer, kHidden1>(*network.GetTransform(1), pairs, hidden1);
+		} else {
+			FixedAvx2::Clamp0<kFirstLayer>(firstLayerValues, inputs);
+			FixedAvx2::ReluLayer<kFirstLayer, kHidden1>(*network.GetTransform(1), inputs, hidden1);
+		}
+		FixedAvx2::ReluLayer<kHidden1, kHidden2>(*network.GetTransform(2), hidden1, hidden2);
+		return FixedAvx2::OutputLayer<kHidden2>(*network.GetTransform(3), hidden2);
+	}
+
+	template<bool kSparse>
+	SIMD_TARGET(AVX512_TARGET) static int SumAvx512(const NeuralNetwork<nnInt_t>& network, const nnInt_t firstLayerValues[])
+	{
+		alignas(64) int16_t inputs[kFirstLayer], hidden1[kHidden1], hidden2[kHidden2];
+		if (kSparse) {
+			NonzeroPairs<kFirstLayer> pairs;
+			FixedAvx512::FindNonzeroPairs<kFirstLayer>(firstLayerValues, pairs);
+			FixedAvx512::SparseReluLayer<kFirstLayer, kHidden1>(*network.GetTransform(1), pairs, hidden1);
+		} else {
+			FixedAvx2::Clamp0<kFirstLayer>(firstLayerValues, inputs);
+			FixedAvx512::ReluLayer<kFirstLayer, kHidden1>(*network.GetTransform(1), inputs, hidden1);
+		}
+		FixedAvx512::ReluLayer<kHidden1, kHidden2>(*network.GetTransform(2), hidden1, hidden2);
+		return FixedAvx2::OutputLayer<kHidden2>(*network.GetTransform(3), hidden2);
+	}
+
+	template<bool kSparse>
+	SIMD_TARGET(VNNI_TARGET) static int SumVnni(const NeuralNetwork<nnInt_t>& network, const nnInt_t firstLayerValues[])
+	{
+		alignas(64) int16_t inputs[kFirstLayer], hidden1[kHidden1], hidden2[kHidden2];
+		if (kSparse) {
+			NonzeroPairs<kFirstLayer> pairs;
+			FixedAvx512::FindNonzeroPairs<kFirstLayer>(firstLayerValues, pairs);
+			FixedAvx512::SparseReluLayerVnni<kFirstLayer, kHidden1>(*network.GetTransform(1), pairs, hidden1);
+		} else {
+			FixedAvx2::Clamp0<kFirstLayer>(firstLayerValues, inputs);
+			FixedAvx512::ReluLayerVnni<kFirstLayer, kHidden1>(*network.GetTransform(1), inputs, hidden1);
+		}
+		FixedAvx512::ReluLayerVnni<kHidden1, kHidden2>(*network.GetTransform(2), hidden1, hidden2);
+		return FixedAvx2::OutputLayer<kHidden2>(*network.GetTransform(3), hidden2);
+	}
+
+	SIMD_TARGET("avx2") static void SumBatchAvx2(const NeuralNetwork<nnInt_t>& network, const nnInt_t* const firstLayerValues[], int sums[])
+	{
+		alignas(64) int16_t inputs[kEvalBatchSize][kFirstLayer], hidden1[kEvalBatchSize][kHidden1], hidden2[kEvalBatchSize][kHidden2];
+		for (int b = 0; b < kEvalBatchSize; b++) { FixedAvx2::Clamp0<kFirstLayer>(firstLayerValues[b], inputs[b]); }
+		FixedAvx2::ReluLayerBatch<kFirstLayer, kHidden1>(*network.GetTransform(1), inputs, hidden1);
+		FixedAvx2::ReluLayerBatch<kHidden1, kHidden2>(*network.GetTransform(2), hidden1, hidden2);
+		for (int b = 0; b < kEvalBatchSize; b++) { sums[b] = FixedAvx2::OutputLayer<kHidden2>(*network.GetTransform(3), hidden2[b]); }
+	}
+
+	SIMD_TARGET(AVX512_TARGET) static void SumBatchAvx512(const NeuralNetwork<nnInt_t>& network, const nnInt_t* const firstLayerValues[], int sums[])
+	{
+		alignas(64) int16_t inputs[kEvalBatchSize][kFirstLayer], hidden1[kEvalBatchSize][kHidden1], hidden2[kEvalBatchSize][kHidden2];
+		for (int b = 0; b < kEvalBatchSize; b++) { FixedAvx2::Clamp0<kFirstLayer>(firstLayerValues[b], inputs[b]); }
+		FixedAvx512::ReluLayerBatch<kFirstLayer, kHidden1>(*network.GetTransform(1), inputs, hidden1);
+		FixedAvx512::ReluLayerBatch<kHidden1, kHidden2>(*network.GetTransform(2), hidden1, hidden2);
+		for (int b = 0; b < kEvalBatchSize; b++) { sums[b] = FixedAvx2::OutputLayer<kHidden2>(*network.GetTransform(3), hidden2[b]); }
+	}
+
+	SIMD_TARGET(VNNI_TARGET) static void SumBatchVnni(const NeuralNetwork<nnInt_t>& network, const nnInt_t* const firstLayerValues[], int sums[])
+	{
+		alignas(64) int16_t inputs[kEvalBatchSize][kFirstLayer], hidden1[kEvalBatchSize][kHidden1], hidden2[kEvalBatchSize][kHidden2];
+		for (int b = 0; b < kEvalBatchSize; b++) { FixedAvx2::Clamp0<kFirstLayer>(firstLayerValues[b], inputs[b]); }
+		FixedAvx512::ReluLayerBatchVnni<kFirstLayer, kHidden1>(*network.GetTransform(1), inputs, hidden1);
+		FixedAvx512::ReluLayerBatchVnni<kHidden1, kHidden2>(*network.GetTransform(2), hidden1, hidden2);
+		for (int b = 0; b < kEvalBatchSize; b++) { sums[b] = FixedAvx2::OutputLayer<kHidden2>(*network.GetTransform(3), hidden2[b]); }
+	}
+};
@@ -0,0 +1,87 @@
+//
+// MappedFile.cpp
+// by Jonathan Kreuzer
+//
+// Read only memory mapping of a whole file. Pages are loaded by the OS as they're first touched,
+// and stay shared with other processes that map the same file.
+//
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+// Map the file, returns true if successful
+bool MappedFile::Open(const char* path)
+{
+	Close();
+#ifdef _WIN32
+	fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	fileMapping = CreateFileMapping(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (fileMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+	data = (const uint8_t*)MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	size = (size_t)fileSize.QuadPart;
+#else
+	fileDescriptor = open(path, O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+	data = (view != MAP_FAILED) ? (const uint8_t*)view : nullptr;
+	size = (size_t)fileStat.st_size;
+#endif
+	if (data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (fileMapping != nullptr)
+		CloseHandle(fileMapping);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+	fileMapping = nullptr;
+	fileHandle = nullptr;
+#else
+	if (data != nullptr)
+		munmap((void*)data, size);
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
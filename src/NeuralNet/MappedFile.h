@@ -0,0 +1,33 @@
+#pragma once
+//
+// MappedFile.h
+// by Jonathan Kreuzer
+//
+// Read only memory mapping of a whole file, so data stored in the layout it's used in can be used in place.
+//
+
+#include <stdint.h>
+#include <stddef.h>
+
+class MappedFile
+{
+public:
+	~MappedFile() { Close(); }
+
+	bool Open(const char* path);
+	void Close();
+	bool IsOpen() const { return data != nullptr; }
+
+	const uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* fileMapping = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
@@ -11,11 +11,25 @@
 #include <sstream>  
 
 #include "NeuralNet.h"
+#include "FixedNetwork.h"
 
 template class NeuralNetwork<nnInt_t>;
 
 std::string neuralNetDir("NN/");
 
+const NonzeroPairLookup g_NonzeroPairLookup;
+
+NonzeroPairLookup::NonzeroPairLookup()
+{
+	for (int mask = 0; mask < 256; mask++)
+	{
+		int count = 0;
+		for (int i = 0; i < 8; i++) { if (mask & (1 << i)) indices[mask][count++] = (uint8_t)i; }
+		this->count[mask] = (uint8_t)count;
+		while (count < 8) { indices[mask][count++] = 0; }
+	}
+}
+
 // -------------------
 // NeuralNetBase
 // -------------------
@@ -35,34 +49,68 @@ void NeuralNetBase::LoadText()
 	isLoaded = network.LoadText(neuralNetFile.c_str());
 }
 
-int NeuralNetBase::ComputeFirstLayerValues(const Board& board, nnInt_t* Values, nnInt_t* firstLayerValues) const
+// The non-activated first layer values are the biases plus the weights of each active input
+int NeuralNetBase::ComputeFirstLayerValues(const Board& board, nnInt_t* firstLayerValues) const
 {
-	ConvertToInputValues(board, Values); // Note : this also sets first-layer values for each input
+	int activeInputs[kMaxActiveInputs];
+	const int activeCount = GetActiveInputs(board, activeInputs);
 
-	// Save the converted board values into first layer values for later
 	const NetworkTransform<nnInt_t>* transform = network.GetTransform(0);
-	nnInt_t* Outputs = network.GetLayerOutputValues(0, Values);
-	memcpy(firstLayerValues, Outputs, sizeof(nnInt_t) * transform->outputCount);
+	if (bFusedInputUpdates)
+	{
+		transform->SetOutputsFromInputs(activeInputs, activeCount, firstLayerValues);
+	}
+	else
+	{
+		transform->SetOutputsToBias(firstLayerValues);
+		for (int i = 0; i < activeCount; i++)
+		{
+			transform->AddInput(activeInputs[i], firstLayerValues);
+		}
+	}
 
 	return transform->outputCount;
 }
 
 // param firstLayerValues = the non-activated output values from the first layer
-int NeuralNetBase::GetSumIncremental(const nnInt_t firstLayerValues[], nnInt_t Values[]) const
+int NeuralNetBase::GetSumIncremental(const nnInt_t firstLayerValues[]) const
 {
+	if (fixedHiddenSum && bUseFixedSum && !network.UsingInt8()) {
+		return fixedHiddenSum(network, firstLayerValues, bSparseFirstLayer);
+	}
+
+	alignas(64) nnInt_t Values[kMaxEvalNetValues];
 	nnInt_t* Outputs = network.GetLayerOutputValues(0, Values);
 	memcpy(Outputs, firstLayerValues, sizeof(nnInt_t) * network.GetLayer(0)->outputCount);
 
 	return GetSum(Values);
 }
 
+// Sums count positions from their first layer values (like GetSumIncremental for each).
+// With a fixed size network and the dense first hidden layer, kEvalBatchSize positions are summed together so they share the weight loads.
+// (The hidden weights stay in L1, so skipping the zero activations of each position with the sparse layer is faster than sharing the loads.)
+void NeuralNetBase::GetSumBatch(const nnInt_t* const firstLayerValues[], int count, int sums[]) const
+{
+	int i = 0;
+	if (fixedHiddenSumBatch && bUseFixedSum && !bSparseFirstLayer && !network.UsingInt8())
+	{
+		for (; i + kEvalBatchSize <= count; i += kEvalBatchSize) {
+			fixedHiddenSumBatch(network, firstLayerValues + i, sums + i);
+		}
+	}
+	for (; i < count; i++) {
+		sums[i] = GetSumIncremental(firstLayerValues[i]);
+	}
+}
+
 // param board = board to convert to inputs. 
-// Note : Values are passed to allow safe multi-threading
-int NeuralNetBase::GetSum(const Board& board, nnInt_t* Values) const
+// Note : the values are on the stack to allow safe multi-threading
+int NeuralNetBase::GetSum(const Board& board) const
 {
-	ConvertToInputValues(board, Values); // Note : this also sets first-layer values for each input
+	alignas(64) nnInt_t firstLayerValues[kMaxValuesInLayer];
+	ComputeFirstLayerValues(board, firstLayerValues);
 
-	return GetSum(Values);
+	return GetSumIncremental(firstLayerValues);
 }
 
 int NeuralNetBase::GetSum(nnInt_t* Inputs) const
@@ -110,19 +158,19 @@ bool NeuralNetwork<T>::Load( const char* filename )
 }
 
 template<typename T>
-void NeuralNetwork<T>::WriteNet(FILE* fp)
+void NeuralNetwork<T>::WriteNet(FILE* fp, uint32_t firstTransform)
 {
 	// Write some structure info
 	fwrite(&layerCount, sizeof(layerCount), 1, fp);
 	fwrite(&inputCount, sizeof(inputCount), 1, fp);
 
 	// Save the weights from each layer
-	for (uint32_t i = 0; i < layerCount; i++)
+	for (uint32_t i = firstTransform; i < layerCount; i++)
 		Transforms[i].Save(fp);
 }
 
 template<typename T>
-bool NeuralNetwork<T>::ReadNet(FILE* fp)
+bool NeuralNetwork<T>::ReadNet(FILE* fp, uint32_t firstTransform)
 {
 	// Make sure the structure matches
 	size_t bytesRead = 0;
@@ -131,14 +179,149 @@ bool NeuralNetwork<T>::ReadNet(FILE* fp)
 	bytesRead += fread(&testInputCount, sizeof(testInputCount), 1, fp);
 
 	if (testLayerCount != layerCount || testInputCount != inputCount) return false;
+	ReleaseMapped();
 
 	// Load the layers
-	for (uint32_t i = 0; i < layerCount; i++)
+	for (uint32_t i = firstTransform; i < layerCount; i++)
 		if (!Transforms[i].Load(fp)) return false;
 
+	QuantizeInt8Layers();
+	return true;
+}
+
+template<typename T>
+void NeuralNetwork<T>::ShareFirstLayer(const NeuralNetwork<T>& owner)
+{
+	const NetworkTransform<T>& ownerTransform = owner.Transforms[0];
+	assert(owner.inputCount == inputCount && ownerTransform.outputCount == Transforms[0].outputCount);
+	assert(Transforms[0].layoutType == eLayout::SPARSE_INPUTS); // no blocked copy to point at the owner's
+
+	Transforms[0].Init(ownerTransform.inputCount, ownerTransform.outputCount, owner.Weights, ownerTransform.weightStart, nullptr, nullptr, ownerTransform.activationType, ownerTransform.layoutType);
+	Transforms[0].OnWeightsLoaded();
+}
+
+static inline size_t Align64(size_t bytes) { return (bytes + 63) & ~(size_t)63; }
+
+static void WritePadded(FILE* fp, const void* data, size_t bytes)
+{
+	static const uint8_t zeros[64] = { 0 };
+	fwrite(data, 1, bytes, fp);
+	fwrite(zeros, 1, Align64(bytes) - bytes, fp);
+}
+
+template<typename T>
+uint32_t NeuralNetwork<T>::MappedBytes(uint32_t firstTransform) const
+{
+	uint32_t weightStarts[kMaxLayers + 1], blockedStarts[kMaxLayers + 1];
+	GetWeightStarts(firstTransform, weightStarts, blockedStarts);
+	return (uint32_t)(sizeof(MappedNetHeader) + (layerCount - firstTransform) * sizeof(MappedTransformData)
+		+ Align64(weightStarts[layerCount] * sizeof(T)) + Align64(blockedStarts[layerCount] * sizeof(T)) + Align64(blockedStarts[layerCount]));
+}
+
+template<typename T>
+void NeuralNetwork<T>::WriteMapped(FILE* fp, uint32_t firstTransform) const
+{
+	assert(firstTransform >= storedFirstTransform);
+	uint32_t weightStarts[kMaxLayers + 1], blockedStarts[kMaxLayers + 1];
+	GetWeightStarts(firstTransform, weightStarts, blockedStarts);
+
+	MappedNetHeader header;
+	memset(&header, 0, sizeof(header));
+	header.netBytes = MappedBytes(firstTransform);
+	header.layerCount = layerCount;
+	header.inputCount = inputCount;
+	header.firstTransform = firstTransform;
+	for (uint32_t l = 0; l < layerCount; l++)
+	{
+		header.outputCounts[l] = Layers[l].outputCount;
+		header.activations[l] = (uint8_t)Layers[l].activationType;
+		header.layouts[l] = (uint8_t)Layers[l].layoutType;
+		if (l >= firstTransform && Transforms[l].bBlocked) header.blockedLayers |= 1 << l;
+		if (l >= firstTransform && Transforms[l].bInt8Quantized) header.int8Layers |= 1 << l;
+	}
+	header.weightCount = weightStarts[layerCount];
+	header.blockedWeightCount = blockedStarts[layerCount];
+	fwrite(&header, sizeof(header), 1, fp);
+
+	for (uint32_t l = firstTransform; l < layerCount; l++)
+	{
+		MappedTransformData transformData;
+		memset(&transformData, 0, sizeof(transformData));
+		memcpy(transformData.biases32, Transforms[l].biases32, Transforms[l].outputCount * sizeof(int32_t));
+		memcpy(transformData.int8Multipliers, Transforms[l].int8Multipliers, Transforms[l].outputCount * sizeof(int32_t));
+		fwrite(&transformData, sizeof(transformData), 1, fp);
+	}
+
+	// Our arrays start at storedFirstTransform, so skip to firstTransform's weights
+	uint32_t storedWeightStarts[kMaxLayers + 1], storedBlockedStarts[kMaxLayers + 1];
+	GetWeightStarts(storedFirstTransform, storedWeightStarts, storedBlockedStarts);
+	WritePadded(fp, &Weights[storedWeightStarts[firstTransform]], header.weightCount * sizeof(T));
+	WritePadded(fp, &BlockedWeights[storedBlockedStarts[firstTransform]], header.blockedWeightCount * sizeof(T));
+	WritePadded(fp, &BlockedWeights8[storedBlockedStarts[firstTransform]], header.blockedWeightCount);
+}
+
+template<typename T>
+bool NeuralNetwork<T>::MatchesMapped(const MappedNetHeader& header, size_t bytes, uint32_t firstTransform) const
+{
+	if (bytes < sizeof(MappedNetHeader) || header.netBytes > bytes || header.netBytes != MappedBytes(firstTransform)) return false;
+	if (header.layerCount != layerCount || header.inputCount != inputCount || header.firstTransform != firstTransform) return false;
+
+	uint32_t weightStarts[kMaxLayers + 1], blockedStarts[kMaxLayers + 1];
+	GetWeightStarts(firstTransform, weightStarts, blockedStarts);
+	if (header.weightCount != weightStarts[layerCount] || header.blockedWeightCount != blockedStarts[layerCount]) return false;
+
+	for (uint32_t l = 0; l < layerCount; l++)
+	{
+		if (header.outputCounts[l] != (uint32_t)Layers[l].outputCount
+			|| header.activations[l] != (uint8_t)Layers[l].activationType
+			|| header.layouts[l] != (uint8_t)Layers[l].layoutType) return false;
+
+		// Only dense layers after the first transform have blocked weights to use
+		const bool bCanBlock = l >= firstTransform && Layers[l].layoutType == eLayout::DENSE;
+		if (!bCanBlock && ((header.blockedLayers | header.int8Layers) & (1 << l))) return false;
+	}
 	return true;
 }
 
+template<typename T>
+void NeuralNetwork<T>::UseMapped(const uint8_t* netData)
+{
+	const MappedNetHeader& header = *(const MappedNetHeader*)netData;
+	const MappedTransformData* transformData = (const MappedTransformData*)(netData + sizeof(MappedNetHeader));
+	const uint8_t* data = (const uint8_t*)(transformData + (layerCount - header.firstTransform));
+
+	// The arrays are never written while they're mapped
+	FreeWeights();
+	bMapped = true;
+	storedFirstTransform = header.firstTransform;
+	Weights = (T*)data;
+	data += Align64(header.weightCount * sizeof(T));
+	BlockedWeights = (T*)data;
+	data += Align64(header.blockedWeightCount * sizeof(T));
+	BlockedWeights8 = (int8_t*)data;
+	InitTransforms(storedFirstTransform);
+
+	for (uint32_t l = storedFirstTransform; l < layerCount; l++)
+	{
+		NetworkTransform<T>& transform = Transforms[l];
+		memcpy(transform.biases32, transformData[l - storedFirstTransform].biases32, transform.outputCount * sizeof(int32_t));
+		memcpy(transform.int8Multipliers, transformData[l - storedFirstTransform].int8Multipliers, transform.outputCount * sizeof(int32_t));
+		transform.bBlocked = (header.blockedLayers & (1 << l)) != 0;
+		transform.bInt8Quantized = (header.int8Layers & (1 << l)) != 0;
+	}
+}
+
+// Switch a mapped net back to its own (zeroed) weights before loading into them
+template<typename T>
+void NeuralNetwork<T>::ReleaseMapped()
+{
+	if (!bMapped) return;
+
+	FreeWeights();
+	AllocWeights();
+	InitTransforms(0);
+}
+
 float ReadFloat(char line[], int& i)
 {
 	const char* numberStr = &line[i];
@@ -221,6 +404,7 @@ uint32_t NeuralNetwork<T>::LoadWeightsFromArray( const std::vector<float>& loade
 	const uint32_t netWeightCount = WeightCount();
 	if (startIdx + netWeightCount <= loadedWeights.size())
 	{
+		ReleaseMapped();
 		for (uint32_t i = 0; i < netWeightCount; i++)
 		{
 			if (IsBias(i))
@@ -297,27 +481,97 @@ void NeuralNetwork<T>::Build()
 		prevOutputCount = Layers[l].outputCount;
 	}
 
-	// Free any allocated weights
-	if (Weights) {
-		delete[] Weights;
+	FreeWeights();
+	AllocWeights();
+	InitTransforms(0);
+
+	assert(ValueMax() < kMaxEvalNetValues);
+}
+
+// Start of each transform's weights, and of its interleaved copies of dense weights, counted from transform firstTransform.
+// The entry after the last transform is the total. Each layer's weights are 32-byte aligned, and the blocked weights 64-byte aligned.
+template<typename T>
+void NeuralNetwork<T>::GetWeightStarts(uint32_t firstTransform, uint32_t weightStarts[kMaxLayers + 1], uint32_t blockedStarts[kMaxLayers + 1]) const
+{
+	uint32_t weightStart = 0;
+	uint32_t blockedStart = 0;
+	for (uint32_t l = 0; l < layerCount; l++)
+	{
+		weightStarts[l] = weightStart;
+		blockedStarts[l] = blockedStart;
+		if (l < firstTransform) continue;
+
+		const uint32_t weights = Layers[l].outputCount * InputCount(l);
+		weightStart += weights + Layers[l].outputCount;
+		if ((weightStart % 16)) weightStart += 16 - (weightStart % 16); // enforce 32-byte alignment
+		if (Layers[l].layoutType == eLayout::DENSE) { blockedStart += (weights + 63) & ~63; }
 	}
+	weightStarts[layerCount] = weightStart;
+	blockedStarts[layerCount] = blockedStart;
+}
+
+template<typename T>
+void NeuralNetwork<T>::AllocWeights()
+{
+	uint32_t weightStarts[kMaxLayers + 1], blockedStarts[kMaxLayers + 1];
+	GetWeightStarts(0, weightStarts, blockedStarts);
 
 	// Allocate the weights
-	const uint32_t maxWeightCount = (weightCount + layerCount * 31);
+	const uint32_t maxWeightCount = std::max(weightStarts[layerCount], weightCount + layerCount * 31);
 	Weights = AlignedAllocUtil<T>(maxWeightCount, 64);
 	memset(Weights, 0, maxWeightCount * sizeof(T));
 
-	// Initialize the layers
-	int weightStart = 0;
-	for (uint32_t l = 0; l < layerCount; l++)
+	// Allocate the interleaved copies of the dense layer weights (int16 and int8), each layer 64-byte aligned
+	const uint32_t blockedWeightCount = std::max(blockedStarts[layerCount], 32u);
+	BlockedWeights = AlignedAllocUtil<T>(blockedWeightCount, 64);
+	memset(BlockedWeights, 0, blockedWeightCount * sizeof(T));
+	BlockedWeights8 = AlignedAllocUtil<int8_t>(blockedWeightCount, 64);
+	memset(BlockedWeights8, 0, blockedWeightCount);
+
+	storedFirstTransform = 0;
+}
+
+template<typename T>
+void NeuralNetwork<T>::FreeWeights()
+{
+	if (!bMapped)
 	{
-		int inputs = l > 0 ? Layers[l - 1].outputCount : inputCount;
-		Transforms[l].Init(inputs, Layers[l].outputCount, Weights, weightStart, Layers[l].activationType, Layers[l].layoutType);
-		weightStart += Transforms[l].WeightCount();
-		if ((weightStart % 16)) weightStart += 16 - (weightStart % 16); // enforce 32-byte alignment
+		if (Weights) AlignedFreeUtil(Weights);
+		if (BlockedWeights) AlignedFreeUtil(BlockedWeights);
+		if (BlockedWeights8) AlignedFreeUtil(BlockedWeights8);
 	}
+	Weights = nullptr;
+	BlockedWeights = nullptr;
+	BlockedWeights8 = nullptr;
+	bMapped = false;
+}
 
-	assert(ValueMax() < kMaxEvalNetValues);
+// Point the transforms at the weight arrays, which start at transform firstTransform's weights.
+// The transforms before it have no weights here (a net sharing its first layer gets it from ShareFirstLayer).
+template<typename T>
+void NeuralNetwork<T>::InitTransforms(uint32_t firstTransform)
+{
+	uint32_t weightStarts[kMaxLayers + 1], blockedStarts[kMaxLayers + 1];
+	GetWeightStarts(firstTransform, weightStarts, blockedStarts);
+
+	for (uint32_t l = 0; l < layerCount; l++)
+	{
+		const int inputs = InputCount(l);
+		if (l < firstTransform)
+		{
+			Transforms[l].Init(inputs, Layers[l].outputCount, nullptr, 0, nullptr, nullptr, Layers[l].activationType, Layers[l].layoutType);
+			continue;
+		}
+
+		T* blockedWeights = nullptr;
+		int8_t* blockedWeights8 = nullptr;
+		if (Layers[l].layoutType == eLayout::DENSE)
+		{
+			blockedWeights = &BlockedWeights[blockedStarts[l]];
+			blockedWeights8 = &BlockedWeights8[blockedStarts[l]];
+		}
+		Transforms[l].Init(inputs, Layers[l].outputCount, Weights, weightStarts[l], blockedWeights, blockedWeights8, Layers[l].activationType, Layers[l].layoutType);
+	}
 }
 
 template<typename T>
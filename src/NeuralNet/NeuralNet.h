@@ -16,6 +16,10 @@ const float kFixedFloatMult = 256.0f;
 const int kFixedMax = (1 << 15) - 1;
 const int kMaxEvalNetValues = 1280;
 const int kMaxValuesInLayer = 256;
+const int kMaxActiveInputs = 64; // inputs set to 1 for a position, listed by NeuralNetBase::GetActiveInputs
+const int kEvalBatchSize = 4; // positions summed together by NeuralNetBase::GetSumBatch
+const int kInt8ActivationShift = 5; // the int8 layer uses its inputs >> 5 (rounded) clamped to 0..127, so 8 = 1.0
+const int kMaxNetLayers = 4;
 
 typedef int16_t nnInt_t;
 
@@ -30,7 +34,17 @@ struct NetworkTransform
 	uint32_t biasStart = 0;
 	int32_t biases32[kMaxValuesInLayer]; // store biases as 32-bit int to memcpy in
 
-	void Init(int inputs, int outputs, T* InWeights, int inWeightStart, eActivation inType, eLayout inLayoutType)
+	// Copy of the dense weights interleaved for SIMD::transformBlockedInt16 (nullptr for sparse layers)
+	T* BlockedWeights = nullptr;
+	bool bBlocked = false;
+
+	// Int8 quantized copy of the dense weights for SIMD::transformBlockedInt8, used when bUseInt8 is set
+	int8_t* BlockedWeights8 = nullptr;
+	int32_t int8Multipliers[kMaxValuesInLayer]; // scales each int8 sum back to the int16 sum (weight scale << kInt8ActivationShift)
+	bool bInt8Quantized = false;
+	bool bUseInt8 = false;
+
+	void Init(int inputs, int outputs, T* InWeights, int inWeightStart, T* InBlockedWeights, int8_t* InBlockedWeights8, eActivation inType, eLayout inLayoutType)
 	{
 		activationType = inType;
 		layoutType = inLayoutType;
@@ -39,6 +53,8 @@ struct NetworkTransform
 		Weights = InWeights;
 		weightStart = inWeightStart;
 		biasStart = inWeightStart + inputCount * outputCount;
+		BlockedWeights = InBlockedWeights;
+		BlockedWeights8 = InBlockedWeights8;
 	}
 
 	void OnWeightsLoaded()
@@ -46,26 +62,90 @@ struct NetworkTransform
 		for (uint32_t o = 0; o < outputCount; o++) {
 			biases32[o] = (int32_t)Weights[biasStart + o] << kFixedShift;
 		}
+
+		// Interleave the weights so blocks of outputs are summed together without horizontal sums :
+		// for each block of kTransformBlockOutputs outputs, for each pair of inputs, the 2 weights of each output in the block
+		bBlocked = BlockedWeights && SIMD::CanBlockTransform(inputCount, outputCount);
+		if (bBlocked)
+		{
+			T* blocked = BlockedWeights;
+			for (uint32_t block = 0; block < outputCount; block += kTransformBlockOutputs)
+			{
+				for (uint32_t i = 0; i < inputCount; i += 2)
+				{
+					for (uint32_t o = block; o < block + kTransformBlockOutputs; o++)
+					{
+						*blocked++ = Weights[WeightIdx(i, o)];
+						*blocked++ = Weights[WeightIdx(i + 1, o)];
+					}
+				}
+			}
+		}
+	}
+
+	// Quantize the weights to int8, each output with its own integer scale so its largest weight fits in -127..127.
+	// The int8 layout is like the blocked one, but with 4 inputs per output for each step.
+	void QuantizeInt8()
+	{
+		bInt8Quantized = false;
+		if (!bBlocked || !BlockedWeights8 || activationType != eActivation::RELU || !SIMD::CanBlockTransformInt8(inputCount, outputCount)) return;
+
+		int weightScale[kMaxValuesInLayer];
+		for (uint32_t o = 0; o < outputCount; o++)
+		{
+			int maxWeight = 0;
+			for (uint32_t i = 0; i < inputCount; i++) { maxWeight = std::max(maxWeight, abs((int)Weights[WeightIdx(i, o)])); }
+			weightScale[o] = std::max((maxWeight + 126) / 127, 1);
+			int8Multipliers[o] = weightScale[o] << kInt8ActivationShift;
+		}
+
+		int8_t* blocked = BlockedWeights8;
+		for (uint32_t block = 0; block < outputCount; block += kTransformBlockOutputs)
+		{
+			for (uint32_t i = 0; i < inputCount; i += 4)
+			{
+				for (uint32_t o = block; o < block + kTransformBlockOutputs; o++)
+				{
+					for (uint32_t k = 0; k < 4; k++)
+					{
+						const int weight = Weights[WeightIdx(i + k, o)];
+						const int rounded = (weight >= 0) ? (weight + weightScale[o] / 2) / weightScale[o] : -((-weight + weightScale[o] / 2) / weightScale[o]);
+						*blocked++ = (int8_t)ClampInt(rounded, -127, 127);
+					}
+				}
+			}
+		}
+		bInt8Quantized = true;
 	}
 	
 	// Transform input network to output network using weights and biases
 	void Transform(T Inputs[], T Outputs[]) const
 	{
 		assert(Inputs && Outputs);
-		const T* weightsForOutput = &Weights[weightStart];
 
 		// Build outputs in int32s starting with bias
 		alignas(64) int32_t OutputsTemp[kMaxValuesInLayer];
-		memcpy(OutputsTemp, biases32, outputCount * sizeof(int32_t));
 
-		// Sum the weighted inputs for this output
-		const int32_t* end = &OutputsTemp[outputCount];
-		for (int32_t* out = OutputsTemp; out < end; out++, weightsForOutput += inputCount)
+		if (bUseInt8 && bInt8Quantized)
 		{
-			*out += SIMD::dotProductInt16(weightsForOutput, Inputs, inputCount);
-			//assert((*out >> kFixedShift) < kFixedMax); // note : simd 32->16 saturates so hopefully not big deal if a few values goes over
+			// int8 weights x uint8 inputs summed in int32, each sum scaled back to the int16 sum before it's added to the bias
+			alignas(64) uint8_t Inputs8[kMaxValuesInLayer];
+			SIMD::convertVec16to8clamp127(Inputs, Inputs8, kInt8ActivationShift, inputCount);
+			memcpy(OutputsTemp, biases32, outputCount * sizeof(int32_t));
+			SIMD::transformBlockedInt8(BlockedWeights8, Inputs8, int8Multipliers, OutputsTemp, inputCount, outputCount);
+			SIMD::convertVec32to16clamp0(OutputsTemp, Outputs, kFixedShift, outputCount);
+			return;
 		}
 
+		memcpy(OutputsTemp, biases32, outputCount * sizeof(int32_t));
+
+		// Sum the weighted inputs for each output
+		// note : simd 32->16 saturates so hopefully not big deal if a few values goes over kFixedMax
+		if (bBlocked)
+			SIMD::transformBlockedInt16(BlockedWeights, Inputs, OutputsTemp, inputCount, outputCount);
+		else
+			SIMD::transformInt16(&Weights[weightStart], Inputs, OutputsTemp, inputCount, outputCount);
+
 		if (activationType == eActivation::RELU)
 		{
 			SIMD::convertVec32to16clamp0(OutputsTemp, Outputs, kFixedShift, outputCount);
@@ -111,15 +191,7 @@ struct NetworkTransform
 		}
 	}
 
-	inline void AddInput(int i, T Inputs[], T Outputs[]) const
-	{
-		assert(i >= 0 && i < (int)inputCount);
-		Inputs[i] = 1; // Note : only doing 1s and 0s which is quicker, would have to refactor to support other value
-
-		SIMD::addVec16(Outputs, &Weights[weightStart + i * outputCount], outputCount);
-	}
-
-	// For incremental updates of first layer values
+	// For computing and incrementally updating first layer values. Inputs are only 1s and 0s, so an input that's set adds its weights.
 	inline void AddInput(int i, T Outputs[]) const
 	{
 		assert(i >= 0 && i < (int)inputCount);
@@ -132,6 +204,23 @@ struct NetworkTransform
 		SIMD::subVec16( Outputs, &Weights[weightStart + i * outputCount], outputCount );
 	}
 
+	// Outputs = Src with the added inputs added and the removed inputs removed, in a single pass over the outputs (Outputs can be Src)
+	inline void UpdateInputs(const T Src[], T Outputs[], const int addInputs[], int addCount, const int removeInputs[], int removeCount) const
+	{
+		assert(addCount <= kMaxActiveInputs && removeCount <= kMaxActiveInputs);
+		const T* adds[kMaxActiveInputs];
+		const T* removes[kMaxActiveInputs];
+		for (int a = 0; a < addCount; a++) { assert(addInputs[a] >= 0 && addInputs[a] < (int)inputCount); adds[a] = &Weights[weightStart + addInputs[a] * outputCount]; }
+		for (int r = 0; r < removeCount; r++) { assert(removeInputs[r] >= 0 && removeInputs[r] < (int)inputCount); removes[r] = &Weights[weightStart + removeInputs[r] * outputCount]; }
+		SIMD::updateVec16(Src, Outputs, adds, addCount, removes, removeCount, outputCount);
+	}
+
+	// Outputs = the biases with the inputs added, in a single pass
+	inline void SetOutputsFromInputs(const int activeInputs[], int activeCount, T Outputs[]) const
+	{
+		UpdateInputs(&Weights[biasStart], Outputs, activeInputs, activeCount, nullptr, 0);
+	}
+
 	uint32_t Size() const { return WeightCount() * sizeof(T); }
 	uint32_t WeightCount() const { return inputCount * outputCount + outputCount; }
 	uint32_t InputCount() const { return inputCount; }
@@ -187,17 +276,58 @@ public:
 	int outputValueStart = 0;
 };
 
+// Mapped net file : a MappedNetsFileHeader, then for each net a MappedNetHeader followed by its data, already in the
+// layout NeuralNetwork uses (biases32 and int8Multipliers for each transform, then Weights, BlockedWeights and BlockedWeights8,
+// each 64-byte aligned), so the file can be memory mapped and used in place. Nothing is converted when it's loaded.
+// The file is only used if the format and the data layout constants all match this build.
+constexpr uint32_t kMappedNetsVersion = 1; // bump when the file layout or the weight layouts change
+struct MappedNetsFileHeader
+{
+	char magic[8];
+	uint32_t fileVersion;
+	uint32_t weightBytes; // sizeof(nnInt_t)
+	uint32_t fixedShift;
+	uint32_t blockOutputs; // kTransformBlockOutputs
+	uint32_t int8ActivationShift;
+	uint32_t maxValuesInLayer;
+	uint32_t netCount;
+	uint32_t reserved;
+	uint64_t fileBytes;
+	uint64_t checksum; // of everything after the header
+	uint8_t padding[8];
+};
+static_assert(sizeof(MappedNetsFileHeader) == 64, "MappedNetsFileHeader should keep the net data 64-byte aligned");
+
+struct MappedNetHeader
+{
+	uint32_t netBytes; // this header and all the net's data
+	uint32_t layerCount;
+	uint32_t inputCount;
+	uint32_t firstTransform; // 1 when the first layer is shared with another net, and isn't stored with this one
+	uint32_t outputCounts[kMaxNetLayers];
+	uint8_t activations[kMaxNetLayers];
+	uint8_t layouts[kMaxNetLayers];
+	uint32_t weightCount; // stored weights from firstTransform on, with the same padding between layers as in memory
+	uint32_t blockedWeightCount;
+	uint32_t blockedLayers; // bit for each transform that has blocked weights
+	uint32_t int8Layers; // bit for each transform that has int8 quantized weights
+	uint8_t padding[8];
+};
+static_assert(sizeof(MappedNetHeader) == 64, "MappedNetHeader should keep the net data 64-byte aligned");
+
+struct MappedTransformData
+{
+	int32_t biases32[kMaxValuesInLayer];
+	int32_t int8Multipliers[kMaxValuesInLayer];
+};
+
 template< typename T >
 class NeuralNetwork
 {
 public:
 	~NeuralNetwork()
 	{
-		if (Weights)
-		{
-			AlignedFreeUtil(Weights);
-			Weights = nullptr;
-		}
+		FreeWeights();
 	}
 
 	void Sum(T InputLayer[], T FinalOutputs[]) const;
@@ -209,8 +339,22 @@ public:
 
 	bool Load( const char* filename );
 	bool Save( const char* filename );
-	void WriteNet(FILE* fp);
-	bool ReadNet(FILE* fp);
+	// firstTransform > 0 writes/reads only the later layers, for nets that share their first layer with another net
+	void WriteNet(FILE* fp, uint32_t firstTransform = 0);
+	bool ReadNet(FILE* fp, uint32_t firstTransform = 0);
+
+	// Use the first layer weights of owner, which needs the same input count and first layer size, instead of our own.
+	// Call again after the owner's weights are (re)loaded.
+	void ShareFirstLayer(const NeuralNetwork& owner);
+
+	// The mapped net format (see MappedNetHeader). WriteMapped needs the weights loaded.
+	// UseMapped points the net at the data in place, which has to stay mapped while it's used. Loading any other weights
+	// afterwards switches back to the net's own memory.
+	uint32_t MappedBytes(uint32_t firstTransform) const;
+	void WriteMapped(FILE* fp, uint32_t firstTransform) const;
+	bool MatchesMapped(const MappedNetHeader& header, size_t bytes, uint32_t firstTransform) const;
+	void UseMapped(const uint8_t* netData);
+	bool IsMapped() const { return bMapped; }
 
 	// For loading from tensor flow
 	bool LoadText( const char* filename );
@@ -238,6 +382,31 @@ public:
 	void OnWeightsLoaded()
 	{
 		for (uint32_t i = 0; i < layerCount; i++) { Transforms[i].OnWeightsLoaded(); }
+		QuantizeInt8Layers();
+	}
+
+	// Only the first hidden layer gets an int8 copy. Its inputs are the first layer sums, which fit 7 bits after kInt8ActivationShift,
+	// but the later hidden layers' inputs use the whole int16 range and lose too much eval accuracy in 8 bits.
+	void QuantizeInt8Layers()
+	{
+		if (layerCount > 1) { Transforms[1].QuantizeInt8(); }
+	}
+
+	// Run the hidden layers that were quantized with the int8 weights
+	void SetUseInt8(bool bUse)
+	{
+		for (uint32_t i = 0; i < layerCount; i++) { Transforms[i].bUseInt8 = bUse; }
+	}
+	bool UsingInt8() const
+	{
+		for (uint32_t i = 0; i < layerCount; i++) { if (Transforms[i].bUseInt8 && Transforms[i].bInt8Quantized) return true; }
+		return false;
+	}
+	int Int8LayerCount() const
+	{
+		int count = 0;
+		for (uint32_t i = 0; i < layerCount; i++) { count += Transforms[i].bInt8Quantized ? 1 : 0; }
+		return count;
 	}
 
 	double GetWeight(int w) const { return Weights[w]; }
@@ -268,7 +437,13 @@ public:
 	const NetworkTransform<T>* GetTransform(int layer) const { return &Transforms[layer]; }
 
 private:
-	static const int kMaxLayers = 4;
+	static const int kMaxLayers = kMaxNetLayers;
+
+	void AllocWeights();
+	void FreeWeights();
+	void InitTransforms(uint32_t firstTransform);
+	void GetWeightStarts(uint32_t firstTransform, uint32_t weightStarts[kMaxLayers + 1], uint32_t blockedStarts[kMaxLayers + 1]) const;
+	void ReleaseMapped();
 
 	NetworkLayer Layers[kMaxLayers];
 	NetworkTransform<T> Transforms[kMaxLayers];
@@ -276,23 +451,41 @@ private:
 	uint32_t inputCount = 0;
 
 	T *Weights = nullptr;
+	T *BlockedWeights = nullptr; // dense layer weights re-ordered for speed, the file and training order stays in Weights
+	int8_t *BlockedWeights8 = nullptr; // int8 quantized copy of the dense layer weights
 	int32_t weightCount = 0;
+	bool bMapped = false; // the weight arrays point into a mapped file instead of our own memory
+	uint32_t storedFirstTransform = 0; // the weight arrays start with this transform's weights
 };
 
+extern std::string neuralNetDir; // directory of the net weight and training files
+
 struct NeuralNetBase
 {
+	virtual ~NeuralNetBase() = default; // the eval nets are deleted through base pointers
 	virtual void InitNetwork() = 0;
 	virtual bool IsActive(const struct Board& board) const = 0;
-	virtual void ConvertToInputValues(const Board& board, nnInt_t InputValues[]) const = 0;
+	// Lists the indices of the inputs that are 1 for the board (all others are 0), returns how many
+	virtual int GetActiveInputs(const Board& board, int activeInputs[kMaxActiveInputs]) const = 0;
 
-	virtual int ComputeFirstLayerValues(const Board& board, nnInt_t* Values, nnInt_t* firstLayerValues) const;
-	virtual int GetSumIncremental(const nnInt_t firstLayerValues[], nnInt_t Values[]) const;
-	virtual int GetSum(const Board& board, nnInt_t* Values) const;
+	virtual int ComputeFirstLayerValues(const Board& board, nnInt_t* firstLayerValues) const;
+	virtual int GetSumIncremental(const nnInt_t firstLayerValues[]) const;
+	void GetSumBatch(const nnInt_t* const firstLayerValues[], int count, int sums[]) const;
+	virtual int GetSum(const Board& board) const;
 	virtual int GetSum(nnInt_t* Values) const;
 
 	virtual void SetFilenames(std::string name);
 	virtual void LoadText();
 
+	// Hidden layer sum specialized for the network's layer sizes (see FixedNetwork.h), set by nets that have one
+	typedef int (*FixedSumFunc)(const NeuralNetwork<nnInt_t>& network, const nnInt_t firstLayerValues[], bool bSparse);
+	FixedSumFunc fixedHiddenSum = nullptr;
+	typedef void (*FixedBatchSumFunc)(const NeuralNetwork<nnInt_t>& network, const nnInt_t* const firstLayerValues[], int sums[]);
+	FixedBatchSumFunc fixedHiddenSumBatch = nullptr;
+	bool bUseFixedSum = true;
+	bool bSparseFirstLayer = true; // only sum the nonzero first layer activations into the next layer
+	bool bFusedInputUpdates = true; // add and remove all of a position's changed inputs in one pass (NetworkTransform::UpdateInputs)
+
 	NeuralNetwork<nnInt_t> network;
 	std::string neuralNetFile;
 	std::string neuralNetFileBin;
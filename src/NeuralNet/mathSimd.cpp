@@ -0,0 +1,895 @@
+//
+// mathSimd.cpp
+// by Jonathan Kreuzer
+//
+// Runtime cpu dispatch for the neural net SIMD kernels.
+// Each kernel set is compiled for its own instruction set, and at startup we bind the best one the cpu supports,
+// so a single binary runs on older cpus and still uses AVX2 / AVX-512 where they are available.
+
+#include "mathSimd.h"
+
+#ifdef __GNUC__
+#include <cpuid.h>
+#endif
+
+// One dot product per output, for the sets without their own transform kernel
+template<int (*dotProduct)(const int16_t*, const int16_t*, size_t)>
+static void transformRows(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+{
+	for (size_t o = 0; o < outputCount; o++, weights += inputCount)
+	{
+		outputs[o] += dotProduct(weights, inputs, inputCount);
+	}
+}
+
+// -------------------
+// Scalar
+// -------------------
+namespace Scalar
+{
+	static int dotProductInt16(const int16_t* v1, const int16_t* v2, size_t count)
+	{
+		int32_t dotSum = 0;
+		for (size_t i = 0; i < count; i++) { dotSum += v1[i] * v2[i]; }
+		return dotSum;
+	}
+
+	static void addVec16(int16_t* v1, const int16_t* v2, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) { v1[i] += v2[i]; }
+	}
+
+	static void subVec16(int16_t* v1, const int16_t* v2, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) { v1[i] -= v2[i]; }
+	}
+
+	static void updateVec16(const int16_t* src, int16_t* dst, const int16_t* const adds[], int addCount, const int16_t* const subs[], int subCount, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			int16_t sum = src[i];
+			for (int a = 0; a < addCount; a++) { sum += adds[a][i]; }
+			for (int s = 0; s < subCount; s++) { sum -= subs[s][i]; }
+			dst[i] = sum;
+		}
+	}
+
+	static void clamp0Vec16(int16_t* v1, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) { v1[i] = std::max(v1[i], (int16_t)0); }
+	}
+
+	static void convertVec32to16clamp0(int32_t* v1, int16_t* v2, const int shift, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) {
+			v2[i] = (int16_t)std::min(std::max(v1[i] >> shift, 0), 32767);
+		}
+	}
+
+	static void transformBlockedInt16(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		for (size_t o = 0; o < outputCount; o += kTransformBlockOutputs)
+		{
+			for (size_t i = 0; i < inputCount; i += 2, weights += 2 * kTransformBlockOutputs)
+			{
+				for (int j = 0; j < kTransformBlockOutputs; j++) {
+					outputs[o + j] += weights[2 * j] * inputs[i] + weights[2 * j + 1] * inputs[i + 1];
+				}
+			}
+		}
+	}
+
+	static void convertVec16to8clamp127(const int16_t* v1, uint8_t* v2, const int shift, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) {
+			v2[i] = (uint8_t)std::min(std::max((std::min(v1[i] + (1 << (shift - 1)), 32767)) >> shift, 0), 127);
+		}
+	}
+
+	// Also used for the SSE2 level, since SSE2 has no unsigned x signed byte multiply
+	static void transformBlockedInt8(const int8_t* weights, const uint8_t* inputs, const int32_t* multipliers, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		for (size_t o = 0; o < outputCount; o += kTransformBlockOutputs)
+		{
+			int32_t sums[kTransformBlockOutputs] = {};
+			for (size_t i = 0; i < inputCount; i += 4, weights += 4 * kTransformBlockOutputs)
+			{
+				for (int j = 0; j < kTransformBlockOutputs; j++) {
+					sums[j] += weights[4 * j] * inputs[i] + weights[4 * j + 1] * inputs[i + 1] + weights[4 * j + 2] * inputs[i + 2] + weights[4 * j + 3] * inputs[i + 3];
+				}
+			}
+			for (int j = 0; j < kTransformBlockOutputs; j++) { outputs[o + j] += sums[j] * multipliers[o + j]; }
+		}
+	}
+}
+
+// -------------------
+// SSE2
+// -------------------
+namespace Sse2
+{
+	SIMD_TARGET("sse2") static int dotProductInt16(const int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* const v1End = v1 + count;
+		__m128i dotSum = _mm_setzero_si128();
+		for (; v1 < v1End; v1 += 8, v2 += 8)
+		{
+			const __m128i temp_1 = _mm_load_si128((__m128i*)v1); // Load the 8 values
+			const __m128i temp_2 = _mm_load_si128((__m128i*)v2); // Load the 8 values
+			dotSum = _mm_add_epi32(dotSum, _mm_madd_epi16(temp_1, temp_2)); // Do the mulitply add, and add result to dotSum
+		}
+
+		// madd16 stores in 4 32-bit values (does adjacent sums) so we have to horizontal sum those
+		dotSum = _mm_add_epi32(dotSum, _mm_shuffle_epi32(dotSum, _MM_SHUFFLE(1, 0, 3, 2)));
+		dotSum = _mm_add_epi32(dotSum, _mm_shuffle_epi32(dotSum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(dotSum);
+	}
+
+	SIMD_TARGET("sse2") static void addVec16(int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* v1End = v1 + count;
+		for (; v1 < v1End; v1 += 8, v2 += 8)
+		{
+			const __m128i temp1 = _mm_load_si128((__m128i*)v1);
+			const __m128i temp2 = _mm_load_si128((__m128i*)v2);
+			_mm_store_si128((__m128i*)v1, _mm_add_epi16(temp1, temp2)); // Sum all 8 and store in v1
+		}
+	}
+
+	SIMD_TARGET("sse2") static void subVec16(int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* v1End = v1 + count;
+		for (; v1 < v1End; v1 += 8, v2 += 8)
+		{
+			const __m128i temp1 = _mm_load_si128((__m128i*)v1);
+			const __m128i temp2 = _mm_load_si128((__m128i*)v2);
+			_mm_store_si128((__m128i*)v1, _mm_sub_epi16(temp1, temp2)); // Subtract all 8 and store in v1
+		}
+	}
+
+	SIMD_TARGET("sse2") static void updateVec16(const int16_t* src, int16_t* dst, const int16_t* const adds[], int addCount, const int16_t* const subs[], int subCount, size_t count)
+	{
+		for (size_t i = 0; i < count; i += 16)
+		{
+			__m128i sumLo = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i sumHi = _mm_loadu_si128((const __m128i*)(src + i + 8));
+			for (int a = 0; a < addCount; a++)
+			{
+				sumLo = _mm_add_epi16(sumLo, _mm_loadu_si128((const __m128i*)(adds[a] + i)));
+				sumHi = _mm_add_epi16(sumHi, _mm_loadu_si128((const __m128i*)(adds[a] + i + 8)));
+			}
+			for (int s = 0; s < subCount; s++)
+			{
+				sumLo = _mm_sub_epi16(sumLo, _mm_loadu_si128((const __m128i*)(subs[s] + i)));
+				sumHi = _mm_sub_epi16(sumHi, _mm_loadu_si128((const __m128i*)(subs[s] + i + 8)));
+			}
+			_mm_store_si128((__m128i*)(dst + i), sumLo);
+			_mm_store_si128((__m128i*)(dst + i + 8), sumHi);
+		}
+	}
+
+	SIMD_TARGET("sse2") static void clamp0Vec16(int16_t* v1, size_t count)
+	{
+		const int16_t* v1End = v1 + count;
+		const __m128i zero = _mm_setzero_si128();
+		for (; v1 < v1End; v1 += 8)
+		{
+			const __m128i temp1 = _mm_load_si128((__m128i*)v1);	// Load the 8 values from v1
+			_mm_store_si128((__m128i*)v1, _mm_max_epi16(temp1, zero)); // clamp to >= 0
+		}
+	}
+
+	SIMD_TARGET("sse2") static void convertVec32to16clamp0(int32_t* v1, int16_t* v2, const int shift, size_t count)
+	{
+		const int32_t* v1End = v1 + count;
+		const __m128i zero = _mm_setzero_si128();
+		for (; v1 < v1End; v1 += 8, v2 += 8)
+		{
+			__m128i a = _mm_load_si128((__m128i*)v1); // load 8 values (32-bit)
+			__m128i b = _mm_load_si128((__m128i*)(v1 + 4));
+			a = _mm_srai_epi32(a, shift); // shift right
+			b = _mm_srai_epi32(b, shift);
+			// pack into 8 values (16-bit) in v2, and also clamp to >= 0
+			_mm_store_si128((__m128i*)v2, _mm_max_epi16(_mm_packs_epi32(a, b), zero));
+		}
+	}
+
+	// For each pair of inputs, madd the pair (broadcast) with the 2 weights of each output, which sums into that output's lane
+	SIMD_TARGET("sse2") static void transformBlockedInt16(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		const int32_t* inputPairs = (const int32_t*)inputs;
+		for (size_t o = 0; o < outputCount; o += kTransformBlockOutputs)
+		{
+			__m128i sum0 = _mm_setzero_si128(), sum1 = _mm_setzero_si128(), sum2 = _mm_setzero_si128(), sum3 = _mm_setzero_si128();
+			for (size_t p = 0; p < inputCount / 2; p++, weights += 2 * kTransformBlockOutputs)
+			{
+				const __m128i in = _mm_set1_epi32(inputPairs[p]);
+				sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_load_si128((const __m128i*)weights), in));
+				sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_load_si128((const __m128i*)(weights + 8)), in));
+				sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_load_si128((const __m128i*)(weights + 16)), in));
+				sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_load_si128((const __m128i*)(weights + 24)), in));
+			}
+			__m128i* out = (__m128i*)(outputs + o);
+			_mm_storeu_si128(out + 0, _mm_add_epi32(_mm_loadu_si128(out + 0), sum0));
+			_mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), sum1));
+			_mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), sum2));
+			_mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), sum3));
+		}
+	}
+
+	SIMD_TARGET("sse2") static void convertVec16to8clamp127(const int16_t* v1, uint8_t* v2, const int shift, size_t count)
+	{
+		const int16_t* v1End = v1 + count;
+		const __m128i max127 = _mm_set1_epi8(127);
+		const __m128i round = _mm_set1_epi16((int16_t)(1 << (shift - 1)));
+		for (; v1 < v1End; v1 += 16, v2 += 16)
+		{
+			// saturating add for the rounding, so large values stay large
+			const __m128i a = _mm_srai_epi16(_mm_adds_epi16(_mm_loadu_si128((const __m128i*)v1), round), shift);
+			const __m128i b = _mm_srai_epi16(_mm_adds_epi16(_mm_loadu_si128((const __m128i*)(v1 + 8)), round), shift);
+			// packus clamps to 0..255, then clamp to <= 127
+			_mm_storeu_si128((__m128i*)v2, _mm_min_epu8(_mm_packus_epi16(a, b), max127));
+		}
+	}
+}
+
+// -------------------
+// AVX2
+// -------------------
+namespace Avx2
+{
+	SIMD_TARGET("avx2") static inline int32_t horizontalSum_8x32(__m256i v)
+	{
+		__m128i hSum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		hSum = _mm_add_epi32(hSum, _mm_shuffle_epi32(hSum, _MM_SHUFFLE(1, 0, 3, 2)));
+		hSum = _mm_add_epi32(hSum, _mm_shuffle_epi32(hSum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(hSum);
+	}
+
+	SIMD_TARGET("avx2") static int dotProductInt16(const int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* const v1End = v1 + count;
+		__m256i dotSum = _mm256_setzero_si256();
+		for (; v1 < v1End; v1 += 16, v2 += 16)
+		{
+			const __m256i temp_1 = _mm256_load_si256((__m256i*)v1);	// Load the 16 values
+			const __m256i temp_2 = _mm256_load_si256((__m256i*)v2); // Load the 16 values
+			dotSum = _mm256_add_epi32(dotSum, _mm256_madd_epi16(temp_1, temp_2)); // Do the mulitply add, and add result to dotSum
+		}
+
+		// madd16 stores in 8 32-bit values (does adjacent sums) so we have to horizontal sum those : https://software.intel.com/content/www/us/en/develop/documentation/cpp-compiler-developer-guide-and-reference/top/compiler-reference/intrinsics/intrinsics-for-intel-advanced-vector-extensions-2/intrinsics-for-arithmetic-operations-2/mm256-madd-epi16.html
+		return horizontalSum_8x32(dotSum);
+	}
+
+	SIMD_TARGET("avx2") static void addVec16(int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* v1End = v1 + count;
+		for (; v1 < v1End; v1 += 16, v2 += 16)
+		{
+			const __m256i temp1 = _mm256_load_si256((__m256i*)v1);	// Load the 16 values from v1
+			const __m256i temp2 = _mm256_load_si256((__m256i*)v2); 	// Load the 16 values from v2
+			_mm256_store_si256((__m256i*)v1, _mm256_add_epi16(temp1, temp2)); // Sum all 16 and store in v1
+		}
+	}
+
+	SIMD_TARGET("avx2") static void subVec16(int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* v1End = v1 + count;
+		for (; v1 < v1End; v1 += 16, v2 += 16)
+		{
+			const __m256i temp1 = _mm256_load_si256((__m256i*)v1);	// Load the 16 values from v1
+			const __m256i temp2 = _mm256_load_si256((__m256i*)v2); 	// Load the 16 values from v2
+			_mm256_store_si256((__m256i*)v1, _mm256_sub_epi16(temp1, temp2)); // Subtract all 16 and store in v1
+		}
+	}
+
+	// 32 values at a time, and a last 16 if count isn't a multiple of 32
+	SIMD_TARGET("avx2") static void updateVec16(const int16_t* src, int16_t* dst, const int16_t* const adds[], int addCount, const int16_t* const subs[], int subCount, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			__m256i sumLo = _mm256_loadu_si256((const __m256i*)(src + i));
+			__m256i sumHi = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+			for (int a = 0; a < addCount; a++)
+			{
+				sumLo = _mm256_add_epi16(sumLo, _mm256_loadu_si256((const __m256i*)(adds[a] + i)));
+				sumHi = _mm256_add_epi16(sumHi, _mm256_loadu_si256((const __m256i*)(adds[a] + i + 16)));
+			}
+			for (int s = 0; s < subCount; s++)
+			{
+				sumLo = _mm256_sub_epi16(sumLo, _mm256_loadu_si256((const __m256i*)(subs[s] + i)));
+				sumHi = _mm256_sub_epi16(sumHi, _mm256_loadu_si256((const __m256i*)(subs[s] + i + 16)));
+			}
+			_mm256_store_si256((__m256i*)(dst + i), sumLo);
+			_mm256_store_si256((__m256i*)(dst + i + 16), sumHi);
+		}
+		if (i < count)
+		{
+			__m256i sum = _mm256_loadu_si256((const __m256i*)(src + i));
+			for (int a = 0; a < addCount; a++) { sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*)(adds[a] + i))); }
+			for (int s = 0; s < subCount; s++) { sum = _mm256_sub_epi16(sum, _mm256_loadu_si256((const __m256i*)(subs[s] + i))); }
+			_mm256_store_si256((__m256i*)(dst + i), sum);
+		}
+	}
+
+	SIMD_TARGET("avx2") static void clamp0Vec16(int16_t* v1, size_t count)
+	{
+		const int16_t* v1End = v1 + count;
+		const __m256i zero = _mm256_setzero_si256();
+		for (; v1 < v1End; v1 += 16)
+		{
+			const __m256i temp1 = _mm256_load_si256((__m256i*)v1);	// Load the 16 values from v1
+			_mm256_store_si256((__m256i*)v1, _mm256_max_epi16(temp1, zero)); // clamp to >= 0
+		}
+	}
+
+	SIMD_TARGET("avx2") static void convertVec32to16clamp0(int32_t* v1, int16_t* v2, const int shift, size_t count)
+	{
+		const int32_t* v1End = v1 + count;
+		const __m256i zero = _mm256_setzero_si256();
+		for (; v1 < v1End; v1 += 16, v2 += 16)
+		{
+			__m256i a = _mm256_load_si256((__m256i*)v1); // load 16 values (32-bit)
+			__m256i b = _mm256_load_si256((__m256i*)(v1 + 8));
+			a = _mm256_srai_epi32(a, shift); // shift right
+			b = _mm256_srai_epi32(b, shift);
+			__m256i result = _mm256_packs_epi32(a, b); // pack into 16 values (16-bit)
+			result = _mm256_permute4x64_epi64(result, 0xD8);
+			_mm256_store_si256((__m256i*)v2, _mm256_max_epi16(result, zero)); // clamp to >= 0 and write into v2
+		}
+	}
+
+	SIMD_TARGET("avx2") static void transformBlockedInt16(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		const int32_t* inputPairs = (const int32_t*)inputs;
+		for (size_t o = 0; o < outputCount; o += kTransformBlockOutputs)
+		{
+			__m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+			size_t p = 0;
+			for (; p + 2 <= inputCount / 2; p += 2, weights += 4 * kTransformBlockOutputs)
+			{
+				// add the products of 2 input pairs before accumulating, to halve the dependent adds
+				const __m256i in0 = _mm256_set1_epi32(inputPairs[p]);
+				const __m256i in1 = _mm256_set1_epi32(inputPairs[p + 1]);
+				sum0 = _mm256_add_epi32(sum0, _mm256_add_epi32(_mm256_madd_epi16(_mm256_load_si256((const __m256i*)weights), in0), _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(weights + 32)), in1)));
+				sum1 = _mm256_add_epi32(sum1, _mm256_add_epi32(_mm256_madd_epi16(_mm256_load_si256((const __m256i*)(weights + 16)), in0), _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(weights + 48)), in1)));
+			}
+			for (; p < inputCount / 2; p++, weights += 2 * kTransformBlockOutputs)
+			{
+				const __m256i in = _mm256_set1_epi32(inputPairs[p]);
+				sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)weights), in));
+				sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(weights + 16)), in));
+			}
+			__m256i* out = (__m256i*)(outputs + o);
+			_mm256_storeu_si256(out + 0, _mm256_add_epi32(_mm256_loadu_si256(out + 0), sum0));
+			_mm256_storeu_si256(out + 1, _mm256_add_epi32(_mm256_loadu_si256(out + 1), sum1));
+		}
+	}
+
+	SIMD_TARGET("avx2") static void convertVec16to8clamp127(const int16_t* v1, uint8_t* v2, const int shift, size_t count)
+	{
+		const int16_t* v1End = v1 + (count & ~31);
+		const __m256i max127 = _mm256_set1_epi8(127);
+		const __m256i round = _mm256_set1_epi16((int16_t)(1 << (shift - 1)));
+		for (; v1 < v1End; v1 += 32, v2 += 32)
+		{
+			const __m256i a = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_loadu_si256((const __m256i*)v1), round), shift);
+			const __m256i b = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_loadu_si256((const __m256i*)(v1 + 16)), round), shift);
+			const __m256i result = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+			_mm256_storeu_si256((__m256i*)v2, _mm256_min_epu8(result, max127));
+		}
+		if (count & 16) { Sse2::convertVec16to8clamp127(v1, v2, shift, 16); }
+	}
+
+	// For each 4 inputs, maddubs the 4 (broadcast) with the 4 weights of each output into 2 16-bit sums, then madd with 1 to add those
+	SIMD_TARGET("avx2") static void transformBlockedInt8(const int8_t* weights, const uint8_t* inputs, const int32_t* multipliers, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		const int32_t* inputQuads = (const int32_t*)inputs;
+		const __m256i ones = _mm256_set1_epi16(1);
+		for (size_t o = 0; o < outputCount; o += kTransformBlockOutputs)
+		{
+			__m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+			for (size_t q = 0; q < inputCount / 4; q++, weights += 4 * kTransformBlockOutputs)
+			{
+				// (the 16-bit sums of 2 quads can't be added before the madd, they could saturate)
+				const __m256i in = _mm256_set1_epi32(inputQuads[q]);
+				sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_maddubs_epi16(in, _mm256_load_si256((const __m256i*)weights)), ones));
+				sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_maddubs_epi16(in, _mm256_load_si256((const __m256i*)(weights + 32))), ones));
+			}
+			__m256i* out = (__m256i*)(outputs + o);
+			const __m256i* mult = (const __m256i*)(multipliers + o);
+			_mm256_storeu_si256(out + 0, _mm256_add_epi32(_mm256_loadu_si256(out + 0), _mm256_mullo_epi32(sum0, _mm256_loadu_si256(mult + 0))));
+			_mm256_storeu_si256(out + 1, _mm256_add_epi32(_mm256_loadu_si256(out + 1), _mm256_mullo_epi32(sum1, _mm256_loadu_si256(mult + 1))));
+		}
+	}
+}
+
+// -------------------
+// AVX-512BW
+// Counts are multiples of 16, so a count that isn't a multiple of 32 finishes with one AVX2 step.
+// Loads are unaligned since the weight rows are only guaranteed 32-byte alignment.
+// -------------------
+namespace Avx512
+{
+	// Returns the sums of the 16 values in each of a, b, c, d, as 4 values
+	SIMD_TARGET(AVX512_TARGET) static inline __m128i horizontalSum_4x16x32(__m512i a, __m512i b, __m512i c, __m512i d)
+	{
+		// within each 128-bit lane : [a0+a2, b0+b2, a1+a3, b1+b3] then [a, b, c, d]
+		const __m512i ab = _mm512_add_epi32(_mm512_unpacklo_epi32(a, b), _mm512_unpackhi_epi32(a, b));
+		const __m512i cd = _mm512_add_epi32(_mm512_unpacklo_epi32(c, d), _mm512_unpackhi_epi32(c, d));
+		const __m512i abcd = _mm512_add_epi32(_mm512_unpacklo_epi64(ab, cd), _mm512_unpackhi_epi64(ab, cd));
+
+		// add the 4 lanes
+		const __m256i sum256 = _mm256_add_epi32(_mm512_castsi512_si256(abcd), _mm512_extracti64x4_epi64(abcd, 1));
+		return _mm_add_epi32(_mm256_castsi256_si128(sum256), _mm256_extracti128_si256(sum256, 1));
+	}
+
+	SIMD_TARGET(AVX512_TARGET) static int dotProductInt16(const int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* const v1End = v1 + (count & ~31);
+		__m512i dotSum = _mm512_setzero_si512();
+		for (; v1 < v1End; v1 += 32, v2 += 32)
+		{
+			const __m512i temp_1 = _mm512_loadu_si512((const void*)v1); // Load the 32 values
+			const __m512i temp_2 = _mm512_loadu_si512((const void*)v2);
+			dotSum = _mm512_add_epi32(dotSum, _mm512_madd_epi16(temp_1, temp_2));
+		}
+
+		int32_t sum = _mm512_reduce_add_epi32(dotSum);
+		if (count & 16) { sum += Avx2::dotProductInt16(v1, v2, 16); }
+		return sum;
+	}
+
+	SIMD_TARGET(AVX512_TARGET) static void addVec16(int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* v1End = v1 + (count & ~31);
+		for (; v1 < v1End; v1 += 32, v2 += 32)
+		{
+			const __m512i temp1 = _mm512_loadu_si512((const void*)v1);
+			const __m512i temp2 = _mm512_loadu_si512((const void*)v2);
+			_mm512_storeu_si512((void*)v1, _mm512_add_epi16(temp1, temp2)); // Sum all 32 and store in v1
+		}
+		if (count & 16) { Avx2::addVec16(v1, v2, 16); }
+	}
+
+	SIMD_TARGET(AVX512_TARGET) static void subVec16(int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* v1End = v1 + (count & ~31);
+		for (; v1 < v1End; v1 += 32, v2 += 32)
+		{
+			const __m512i temp1 = _mm512_loadu_si512((const void*)v1);
+			const __m512i temp2 = _mm512_loadu_si512((const void*)v2);
+			_mm512_storeu_si512((void*)v1, _mm512_sub_epi16(temp1, temp2)); // Subtract all 32 and store in v1
+		}
+		if (count & 16) { Avx2::subVec16(v1, v2, 16); }
+	}
+
+	// 64 values at a time, with masked loads and stores for the rest
+	SIMD_TARGET(AVX512_TARGET) static void updateVec16(const int16_t* src, int16_t* dst, const int16_t* const adds[], int addCount, const int16_t* const subs[], int subCount, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 64 <= count; i += 64)
+		{
+			__m512i sumLo = _mm512_loadu_si512((const void*)(src + i));
+			__m512i sumHi = _mm512_loadu_si512((const void*)(src + i + 32));
+			for (int a = 0; a < addCount; a++)
+			{
+				sumLo = _mm512_add_epi16(sumLo, _mm512_loadu_si512((const void*)(adds[a] + i)));
+				sumHi = _mm512_add_epi16(sumHi, _mm512_loadu_si512((const void*)(adds[a] + i + 32)));
+			}
+			for (int s = 0; s < subCount; s++)
+			{
+				sumLo = _mm512_sub_epi16(sumLo, _mm512_loadu_si512((const void*)(subs[s] + i)));
+				sumHi = _mm512_sub_epi16(sumHi, _mm512_loadu_si512((const void*)(subs[s] + i + 32)));
+			}
+			_mm512_storeu_si512((void*)(dst + i), sumLo);
+			_mm512_storeu_si512((void*)(dst + i + 32), sumHi);
+		}
+		for (; i < count; i += 32)
+		{
+			const __mmask32 mask = (count - i >= 32) ? 0xFFFFFFFF : ((1u << (count - i)) - 1);
+			__m512i sum = _mm512_maskz_loadu_epi16(mask, src + i);
+			for (int a = 0; a < addCount; a++) { sum = _mm512_add_epi16(sum, _mm512_maskz_loadu_epi16(mask, adds[a] + i)); }
+			for (int s = 0; s < subCount; s++) { sum = _mm512_sub_epi16(sum, _mm512_maskz_loadu_epi16(mask, subs[s] + i)); }
+			_mm512_mask_storeu_epi16(dst + i, mask, sum);
+		}
+	}
+
+	SIMD_TARGET(AVX512_TARGET) static void clamp0Vec16(int16_t* v1, size_t count)
+	{
+		const int16_t* v1End = v1 + (count & ~31);
+		const __m512i zero = _mm512_setzero_si512();
+		for (; v1 < v1End; v1 += 32)
+		{
+			const __m512i temp1 = _mm512_loadu_si512((const void*)v1);
+			_mm512_storeu_si512((void*)v1, _mm512_max_epi16(temp1, zero)); // clamp to >= 0
+		}
+		if (count & 16) { Avx2::clamp0Vec16(v1, 16); }
+	}
+
+	SIMD_TARGET(AVX512_TARGET) static void convertVec32to16clamp0(int32_t* v1, int16_t* v2, const int shift, size_t count)
+	{
+		const int32_t* v1End = v1 + (count & ~31);
+		const __m512i zero = _mm512_setzero_si512();
+		// packs works within 128-bit lanes, this puts the 64-bit halves back in order
+		const __m512i packOrder = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+		for (; v1 < v1End; v1 += 32, v2 += 32)
+		{
+			__m512i a = _mm512_loadu_si512((const void*)v1); // load 32 values (32-bit)
+			__m512i b = _mm512_loadu_si512((const void*)(v1 + 16));
+			a = _mm512_srai_epi32(a, shift); // shift right
+			b = _mm512_srai_epi32(b, shift);
+			__m512i result = _mm512_permutexvar_epi64(packOrder, _mm512_packs_epi32(a, b)); // pack into 32 values (16-bit)
+			_mm512_storeu_si512((void*)v2, _mm512_max_epi16(result, zero)); // clamp to >= 0 and write into v2
+		}
+		if (count & 16) { Avx2::convertVec32to16clamp0(v1, v2, shift, 16); }
+	}
+
+	// Does 4 outputs at a time, so the horizontal sums of their dot products are shared
+	SIMD_TARGET(AVX512_TARGET) static void transformInt16(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		if ((inputCount & 31) || (outputCount & 3)) {
+			transformRows<dotProductInt16>(weights, inputs, outputs, inputCount, outputCount);
+			return;
+		}
+
+		for (size_t o = 0; o < outputCount; o += 4, weights += 4 * inputCount)
+		{
+			__m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512(), sum2 = _mm512_setzero_si512(), sum3 = _mm512_setzero_si512();
+			for (size_t i = 0; i < inputCount; i += 32)
+			{
+				const __m512i in = _mm512_loadu_si512((const void*)(inputs + i));
+				sum0 = _mm512_add_epi32(sum0, _mm512_madd_epi16(_mm512_loadu_si512((const void*)(weights + i)), in));
+				sum1 = _mm512_add_epi32(sum1, _mm512_madd_epi16(_mm512_loadu_si512((const void*)(weights + inputCount + i)), in));
+				sum2 = _mm512_add_epi32(sum2, _mm512_madd_epi16(_mm512_loadu_si512((const void*)(weights + 2 * inputCount + i)), in));
+				sum3 = _mm512_add_epi32(sum3, _mm512_madd_epi16(_mm512_loadu_si512((const void*)(weights + 3 * inputCount + i)), in));
+			}
+			const __m128i out = _mm_loadu_si128((const __m128i*)(outputs + o));
+			_mm_storeu_si128((__m128i*)(outputs + o), _mm_add_epi32(out, horizontalSum_4x16x32(sum0, sum1, sum2, sum3)));
+		}
+	}
+
+	// A whole block of 16 outputs fits in one register, so do 2 blocks per pass to share each broadcast input pair
+	SIMD_TARGET(AVX512_TARGET) static void transformBlockedInt16(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		const int32_t* inputPairs = (const int32_t*)inputs;
+		const size_t pairCount = inputCount / 2;
+		const size_t blockWeights = pairCount * 2 * kTransformBlockOutputs;
+		size_t o = 0;
+		for (; o + 2 * kTransformBlockOutputs <= outputCount; o += 2 * kTransformBlockOutputs, weights += 2 * blockWeights)
+		{
+			const int16_t* w0 = weights;
+			const int16_t* w1 = weights + blockWeights;
+			__m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512();
+			size_t p = 0;
+			for (; p + 2 <= pairCount; p += 2, w0 += 64, w1 += 64)
+			{
+				// add the products of 2 input pairs before accumulating, to halve the dependent adds
+				const __m512i in0 = _mm512_set1_epi32(inputPairs[p]);
+				const __m512i in1 = _mm512_set1_epi32(inputPairs[p + 1]);
+				sum0 = _mm512_add_epi32(sum0, _mm512_add_epi32(_mm512_madd_epi16(_mm512_load_si512((const void*)w0), in0), _mm512_madd_epi16(_mm512_load_si512((const void*)(w0 + 32)), in1)));
+				sum1 = _mm512_add_epi32(sum1, _mm512_add_epi32(_mm512_madd_epi16(_mm512_load_si512((const void*)w1), in0), _mm512_madd_epi16(_mm512_load_si512((const void*)(w1 + 32)), in1)));
+			}
+			for (; p < pairCount; p++, w0 += 32, w1 += 32)
+			{
+				const __m512i in = _mm512_set1_epi32(inputPairs[p]);
+				sum0 = _mm512_add_epi32(sum0, _mm512_madd_epi16(_mm512_load_si512((const void*)w0), in));
+				sum1 = _mm512_add_epi32(sum1, _mm512_madd_epi16(_mm512_load_si512((const void*)w1), in));
+			}
+			_mm512_storeu_si512((void*)(outputs + o), _mm512_add_epi32(_mm512_loadu_si512((const void*)(outputs + o)), sum0));
+			_mm512_storeu_si512((void*)(outputs + o + 16), _mm512_add_epi32(_mm512_loadu_si512((const void*)(outputs + o + 16)), sum1));
+		}
+		if (o < outputCount)
+		{
+			__m512i sum = _mm512_setzero_si512();
+			for (size_t p = 0; p < pairCount; p++)
+			{
+				sum = _mm512_add_epi32(sum, _mm512_madd_epi16(_mm512_load_si512((const void*)(weights + p * 2 * kTransformBlockOutputs)), _mm512_set1_epi32(inputPairs[p])));
+			}
+			_mm512_storeu_si512((void*)(outputs + o), _mm512_add_epi32(_mm512_loadu_si512((const void*)(outputs + o)), sum));
+		}
+	}
+
+	SIMD_TARGET(AVX512_TARGET) static inline __m512i dotQuads(const int8_t* weights, __m512i in, __m512i ones)
+	{
+		return _mm512_madd_epi16(_mm512_maddubs_epi16(in, _mm512_load_si512((const void*)weights)), ones);
+	}
+
+	// outputs += sum * multipliers, for a block of 16 outputs
+	SIMD_TARGET(AVX512_TARGET) static inline void addScaledBlock(int32_t* outputs, const int32_t* multipliers, __m512i sum)
+	{
+		const __m512i scaled = _mm512_mullo_epi32(sum, _mm512_loadu_si512((const void*)multipliers));
+		_mm512_storeu_si512((void*)outputs, _mm512_add_epi32(_mm512_loadu_si512((const void*)outputs), scaled));
+	}
+
+	// Same as the int16 version, a block of 16 outputs for 4 inputs is one register
+	SIMD_TARGET(AVX512_TARGET) static void transformBlockedInt8(const int8_t* weights, const uint8_t* inputs, const int32_t* multipliers, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		const int32_t* inputQuads = (const int32_t*)inputs;
+		const size_t quadCount = inputCount / 4;
+		const size_t blockWeights = quadCount * 4 * kTransformBlockOutputs;
+		const __m512i ones = _mm512_set1_epi16(1);
+		size_t o = 0;
+		for (; o + 2 * kTransformBlockOutputs <= outputCount; o += 2 * kTransformBlockOutputs, weights += 2 * blockWeights)
+		{
+			const int8_t* w0 = weights;
+			const int8_t* w1 = weights + blockWeights;
+			__m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512();
+			for (size_t q = 0; q < quadCount; q++, w0 += 64, w1 += 64)
+			{
+				const __m512i in = _mm512_set1_epi32(inputQuads[q]);
+				sum0 = _mm512_add_epi32(sum0, dotQuads(w0, in, ones));
+				sum1 = _mm512_add_epi32(sum1, dotQuads(w1, in, ones));
+			}
+			addScaledBlock(outputs + o, multipliers + o, sum0);
+			addScaledBlock(outputs + o + 16, multipliers + o + 16, sum1);
+		}
+		if (o < outputCount)
+		{
+			__m512i sum = _mm512_setzero_si512();
+			for (size_t q = 0; q < quadCount; q++, weights += 64)
+			{
+				sum = _mm512_add_epi32(sum, dotQuads(weights, _mm512_set1_epi32(inputQuads[q]), ones));
+			}
+			addScaledBlock(outputs + o, multipliers + o, sum);
+		}
+	}
+}
+
+// -------------------
+// AVX-512 VNNI : vpdpwssd does the multiply, the adjacent add and the accumulate in one instruction
+// -------------------
+namespace Vnni
+{
+	SIMD_TARGET(VNNI_TARGET) static int dotProductInt16(const int16_t* v1, const int16_t* v2, size_t count)
+	{
+		const int16_t* const v1End = v1 + (count & ~31);
+		__m512i dotSum = _mm512_setzero_si512();
+		for (; v1 < v1End; v1 += 32, v2 += 32)
+		{
+			dotSum = _mm512_dpwssd_epi32(dotSum, _mm512_loadu_si512((const void*)v1), _mm512_loadu_si512((const void*)v2));
+		}
+
+		int32_t sum = _mm512_reduce_add_epi32(dotSum);
+		if (count & 16) { sum += Avx2::dotProductInt16(v1, v2, 16); }
+		return sum;
+	}
+
+	SIMD_TARGET(VNNI_TARGET) static void transformInt16(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		if ((inputCount & 31) || (outputCount & 3)) {
+			transformRows<dotProductInt16>(weights, inputs, outputs, inputCount, outputCount);
+			return;
+		}
+
+		for (size_t o = 0; o < outputCount; o += 4, weights += 4 * inputCount)
+		{
+			__m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512(), sum2 = _mm512_setzero_si512(), sum3 = _mm512_setzero_si512();
+			for (size_t i = 0; i < inputCount; i += 32)
+			{
+				const __m512i in = _mm512_loadu_si512((const void*)(inputs + i));
+				sum0 = _mm512_dpwssd_epi32(sum0, _mm512_loadu_si512((const void*)(weights + i)), in);
+				sum1 = _mm512_dpwssd_epi32(sum1, _mm512_loadu_si512((const void*)(weights + inputCount + i)), in);
+				sum2 = _mm512_dpwssd_epi32(sum2, _mm512_loadu_si512((const void*)(weights + 2 * inputCount + i)), in);
+				sum3 = _mm512_dpwssd_epi32(sum3, _mm512_loadu_si512((const void*)(weights + 3 * inputCount + i)), in);
+			}
+			const __m128i out = _mm_loadu_si128((const __m128i*)(outputs + o));
+			_mm_storeu_si128((__m128i*)(outputs + o), _mm_add_epi32(out, Avx512::horizontalSum_4x16x32(sum0, sum1, sum2, sum3)));
+		}
+	}
+
+	// vpdpwssd accumulates in place, so each block has 4 sums (one per input pair mod 4) to not wait on its latency,
+	// and 2 blocks are done per pass to share each broadcast input pair
+	SIMD_TARGET(VNNI_TARGET) static inline __m512i blockSum4(const int16_t* weights, const int32_t* inputPairs, size_t pairCount)
+	{
+		__m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512(), sum2 = _mm512_setzero_si512(), sum3 = _mm512_setzero_si512();
+		size_t p = 0;
+		for (; p + 4 <= pairCount; p += 4, weights += 8 * kTransformBlockOutputs)
+		{
+			sum0 = _mm512_dpwssd_epi32(sum0, _mm512_set1_epi32(inputPairs[p]), _mm512_load_si512((const void*)weights));
+			sum1 = _mm512_dpwssd_epi32(sum1, _mm512_set1_epi32(inputPairs[p + 1]), _mm512_load_si512((const void*)(weights + 32)));
+			sum2 = _mm512_dpwssd_epi32(sum2, _mm512_set1_epi32(inputPairs[p + 2]), _mm512_load_si512((const void*)(weights + 64)));
+			sum3 = _mm512_dpwssd_epi32(sum3, _mm512_set1_epi32(inputPairs[p + 3]), _mm512_load_si512((const void*)(weights + 96)));
+		}
+		for (; p < pairCount; p++, weights += 2 * kTransformBlockOutputs)
+		{
+			sum0 = _mm512_dpwssd_epi32(sum0, _mm512_set1_epi32(inputPairs[p]), _mm512_load_si512((const void*)weights));
+		}
+		return _mm512_add_epi32(_mm512_add_epi32(sum0, sum1), _mm512_add_epi32(sum2, sum3));
+	}
+
+	SIMD_TARGET(VNNI_TARGET) static void transformBlockedInt16(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		const int32_t* inputPairs = (const int32_t*)inputs;
+		const size_t pairCount = inputCount / 2;
+		const size_t blockWeights = pairCount * 2 * kTransformBlockOutputs;
+		size_t o = 0;
+		for (; o + 2 * kTransformBlockOutputs <= outputCount; o += 2 * kTransformBlockOutputs, weights += 2 * blockWeights)
+		{
+			const int16_t* w0 = weights;
+			const int16_t* w1 = weights + blockWeights;
+			__m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512(), a2 = _mm512_setzero_si512(), a3 = _mm512_setzero_si512();
+			__m512i b0 = _mm512_setzero_si512(), b1 = _mm512_setzero_si512(), b2 = _mm512_setzero_si512(), b3 = _mm512_setzero_si512();
+			size_t p = 0;
+			for (; p + 4 <= pairCount; p += 4, w0 += 128, w1 += 128)
+			{
+				__m512i in = _mm512_set1_epi32(inputPairs[p]);
+				a0 = _mm512_dpwssd_epi32(a0, in, _mm512_load_si512((const void*)w0));
+				b0 = _mm512_dpwssd_epi32(b0, in, _mm512_load_si512((const void*)w1));
+				in = _mm512_set1_epi32(inputPairs[p + 1]);
+				a1 = _mm512_dpwssd_epi32(a1, in, _mm512_load_si512((const void*)(w0 + 32)));
+				b1 = _mm512_dpwssd_epi32(b1, in, _mm512_load_si512((const void*)(w1 + 32)));
+				in = _mm512_set1_epi32(inputPairs[p + 2]);
+				a2 = _mm512_dpwssd_epi32(a2, in, _mm512_load_si512((const void*)(w0 + 64)));
+				b2 = _mm512_dpwssd_epi32(b2, in, _mm512_load_si512((const void*)(w1 + 64)));
+				in = _mm512_set1_epi32(inputPairs[p + 3]);
+				a3 = _mm512_dpwssd_epi32(a3, in, _mm512_load_si512((const void*)(w0 + 96)));
+				b3 = _mm512_dpwssd_epi32(b3, in, _mm512_load_si512((const void*)(w1 + 96)));
+			}
+			for (; p < pairCount; p++, w0 += 32, w1 += 32)
+			{
+				const __m512i in = _mm512_set1_epi32(inputPairs[p]);
+				a0 = _mm512_dpwssd_epi32(a0, in, _mm512_load_si512((const void*)w0));
+				b0 = _mm512_dpwssd_epi32(b0, in, _mm512_load_si512((const void*)w1));
+			}
+			const __m512i sumA = _mm512_add_epi32(_mm512_add_epi32(a0, a1), _mm512_add_epi32(a2, a3));
+			const __m512i sumB = _mm512_add_epi32(_mm512_add_epi32(b0, b1), _mm512_add_epi32(b2, b3));
+			_mm512_storeu_si512((void*)(outputs + o), _mm512_add_epi32(_mm512_loadu_si512((const void*)(outputs + o)), sumA));
+			_mm512_storeu_si512((void*)(outputs + o + 16), _mm512_add_epi32(_mm512_loadu_si512((const void*)(outputs + o + 16)), sumB));
+		}
+		if (o < outputCount)
+		{
+			const __m512i sum = blockSum4(weights, inputPairs, pairCount);
+			_mm512_storeu_si512((void*)(outputs + o), _mm512_add_epi32(_mm512_loadu_si512((const void*)(outputs + o)), sum));
+		}
+	}
+
+	// vpdpbusd does the unsigned x signed byte multiply, the add of each 4 and the accumulate in one instruction.
+	// Like the int16 version, 4 sums per block so the accumulates don't wait on each other.
+	SIMD_TARGET(VNNI_TARGET) static void transformBlockedInt8(const int8_t* weights, const uint8_t* inputs, const int32_t* multipliers, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		const int32_t* inputQuads = (const int32_t*)inputs;
+		const size_t quadCount = inputCount / 4;
+		const size_t blockWeights = quadCount * 4 * kTransformBlockOutputs;
+		size_t o = 0;
+		for (; o + 2 * kTransformBlockOutputs <= outputCount; o += 2 * kTransformBlockOutputs, weights += 2 * blockWeights)
+		{
+			const int8_t* w0 = weights;
+			const int8_t* w1 = weights + blockWeights;
+			__m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512(), a2 = _mm512_setzero_si512(), a3 = _mm512_setzero_si512();
+			__m512i b0 = _mm512_setzero_si512(), b1 = _mm512_setzero_si512(), b2 = _mm512_setzero_si512(), b3 = _mm512_setzero_si512();
+			size_t q = 0;
+			for (; q + 4 <= quadCount; q += 4, w0 += 256, w1 += 256)
+			{
+				__m512i in = _mm512_set1_epi32(inputQuads[q]);
+				a0 = _mm512_dpbusd_epi32(a0, in, _mm512_load_si512((const void*)w0));
+				b0 = _mm512_dpbusd_epi32(b0, in, _mm512_load_si512((const void*)w1));
+				in = _mm512_set1_epi32(inputQuads[q + 1]);
+				a1 = _mm512_dpbusd_epi32(a1, in, _mm512_load_si512((const void*)(w0 + 64)));
+				b1 = _mm512_dpbusd_epi32(b1, in, _mm512_load_si512((const void*)(w1 + 64)));
+				in = _mm512_set1_epi32(inputQuads[q + 2]);
+				a2 = _mm512_dpbusd_epi32(a2, in, _mm512_load_si512((const void*)(w0 + 128)));
+				b2 = _mm512_dpbusd_epi32(b2, in, _mm512_load_si512((const void*)(w1 + 128)));
+				in = _mm512_set1_epi32(inputQuads[q + 3]);
+				a3 = _mm512_dpbusd_epi32(a3, in, _mm512_load_si512((const void*)(w0 + 192)));
+				b3 = _mm512_dpbusd_epi32(b3, in, _mm512_load_si512((const void*)(w1 + 192)));
+			}
+			for (; q < quadCount; q++, w0 += 64, w1 += 64)
+			{
+				const __m512i in = _mm512_set1_epi32(inputQuads[q]);
+				a0 = _mm512_dpbusd_epi32(a0, in, _mm512_load_si512((const void*)w0));
+				b0 = _mm512_dpbusd_epi32(b0, in, _mm512_load_si512((const void*)w1));
+			}
+			Avx512::addScaledBlock(outputs + o, multipliers + o, _mm512_add_epi32(_mm512_add_epi32(a0, a1), _mm512_add_epi32(a2, a3)));
+			Avx512::addScaledBlock(outputs + o + 16, multipliers + o + 16, _mm512_add_epi32(_mm512_add_epi32(b0, b1), _mm512_add_epi32(b2, b3)));
+		}
+		if (o < outputCount)
+		{
+			__m512i sum = _mm512_setzero_si512();
+			for (size_t q = 0; q < quadCount; q++, weights += 64)
+			{
+				sum = _mm512_dpbusd_epi32(sum, _mm512_set1_epi32(inputQuads[q]), _mm512_load_si512((const void*)weights));
+			}
+			Avx512::addScaledBlock(outputs + o, multipliers + o, sum);
+		}
+	}
+}
+
+// -------------------
+// Cpu detection and dispatch
+// -------------------
+static void Cpuid(int info[4], int leaf, int subleaf)
+{
+#ifdef __GNUC__
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#else
+	__cpuidex(info, leaf, subleaf);
+#endif
+}
+
+// Which register states the OS saves on context switches
+static uint64_t GetXCR0()
+{
+#ifdef __GNUC__
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#else
+	return _xgetbv(0);
+#endif
+}
+
+eSimdLevel SIMD::DetectCpuLevel()
+{
+	int info[4];
+	Cpuid(info, 0, 0);
+	const int maxLeaf = info[0];
+
+	Cpuid(info, 1, 0);
+	if (!(info[3] & (1 << 26))) return eSimdLevel::SCALAR; // SSE2
+	const bool bOsxsave = (info[2] & (1 << 27)) != 0;
+	const bool bAvx = (info[2] & (1 << 28)) != 0;
+	if (!bOsxsave || !bAvx || maxLeaf < 7) return eSimdLevel::SSE2;
+
+	// The OS has to save the ymm (and for AVX-512 the opmask and zmm) registers too
+	const uint64_t xcr0 = GetXCR0();
+	if ((xcr0 & 0x6) != 0x6) return eSimdLevel::SSE2;
+
+	Cpuid(info, 7, 0);
+	const bool bAvx2 = (info[1] & (1 << 5)) != 0;
+	const bool bAvx512F = (info[1] & (1 << 16)) != 0;
+	const bool bAvx512BW = (info[1] & (1 << 30)) != 0;
+	const bool bAvx512Vnni = (info[2] & (1 << 11)) != 0;
+	if (!bAvx2) return eSimdLevel::SSE2;
+	if (!bAvx512F || !bAvx512BW || (xcr0 & 0xE0) != 0xE0) return eSimdLevel::AVX2;
+
+	return bAvx512Vnni ? eSimdLevel::AVX512_VNNI : eSimdLevel::AVX512BW;
+}
+
+const char* SIMD::LevelName(eSimdLevel level)
+{
+	switch (level)
+	{
+	case eSimdLevel::SCALAR: return "Scalar";
+	case eSimdLevel::SSE2: return "SSE2";
+	case eSimdLevel::AVX2: return "AVX2";
+	case eSimdLevel::AVX512BW: return "AVX-512BW";
+	case eSimdLevel::AVX512_VNNI: return "AVX-512 VNNI";
+	}
+	return "Unknown";
+}
+
+static SimdKernels GetKernels(eSimdLevel level)
+{
+	switch (level)
+	{
+	case eSimdLevel::SCALAR:
+		return { level, Scalar::dotProductInt16, Scalar::addVec16, Scalar::subVec16, Scalar::updateVec16, Scalar::clamp0Vec16, Scalar::convertVec32to16clamp0, transformRows<Scalar::dotProductInt16>, Scalar::transformBlockedInt16,
+			Scalar::convertVec16to8clamp127, Scalar::transformBlockedInt8 };
+	case eSimdLevel::SSE2:
+		return { level, Sse2::dotProductInt16, Sse2::addVec16, Sse2::subVec16, Sse2::updateVec16, Sse2::clamp0Vec16, Sse2::convertVec32to16clamp0, transformRows<Sse2::dotProductInt16>, Sse2::transformBlockedInt16,
+			Sse2::convertVec16to8clamp127, Scalar::transformBlockedInt8 };
+	case eSimdLevel::AVX2:
+		return { level, Avx2::dotProductInt16, Avx2::addVec16, Avx2::subVec16, Avx2::updateVec16, Avx2::clamp0Vec16, Avx2::convertVec32to16clamp0, transformRows<Avx2::dotProductInt16>, Avx2::transformBlockedInt16,
+			Avx2::convertVec16to8clamp127, Avx2::transformBlockedInt8 };
+	case eSimdLevel::AVX512BW:
+		return { level, Avx512::dotProductInt16, Avx512::addVec16, Avx512::subVec16, Avx512::updateVec16, Avx512::clamp0Vec16, Avx512::convertVec32to16clamp0, Avx512::transformInt16, Avx512::transformBlockedInt16,
+			Avx2::convertVec16to8clamp127, Avx512::transformBlockedInt8 };
+	case eSimdLevel::AVX512_VNNI:
+		return { level, Vnni::dotProductInt16, Avx512::addVec16, Avx512::subVec16, Avx512::updateVec16, Avx512::clamp0Vec16, Avx512::convertVec32to16clamp0, Vnni::transformInt16, Vnni::transformBlockedInt16,
+			Avx2::convertVec16to8clamp127, Vnni::transformBlockedInt8 };
+	}
+	return GetKernels(eSimdLevel::SCALAR);
+}
+
+// Bind the kernels for a level. Returns false if the cpu doesn't support it.
+bool SIMD::SetKernelLevel(eSimdLevel level)
+{
+	if (level > DetectCpuLevel()) return false;
+	kernels = GetKernels(level);
+	return true;
+}
+
+SimdKernels SIMD::kernels = GetKernels(SIMD::DetectCpuLevel());
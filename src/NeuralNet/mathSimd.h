@@ -15,9 +15,45 @@
 
 #include "../defines.h"
 
+// Compiles a function for an instruction set, so it can be picked at runtime (MSVC allows any intrinsics without it)
+#ifdef __GNUC__
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+#define AVX512_TARGET "avx2,avx512f,avx512bw"
+#define VNNI_TARGET "avx2,avx512f,avx512bw,avx512vnni"
+
+// Outputs summed together by transformBlockedInt16, the interleaved weight layout depends on this
+const int kTransformBlockOutputs = 16;
+
+// Instruction sets we have kernels for, in order so a higher level includes the ones before it
+enum class eSimdLevel { SCALAR, SSE2, AVX2, AVX512BW, AVX512_VNNI };
+
+// The kernels used by the neural nets, bound at startup to the best set the cpu supports (see mathSimd.cpp)
+struct SimdKernels
+{
+	eSimdLevel level;
+	int (*dotProductInt16)(const int16_t* v1, const int16_t* v2, size_t count);
+	void (*addVec16)(int16_t* v1, const int16_t* v2, size_t count);
+	void (*subVec16)(int16_t* v1, const int16_t* v2, size_t count);
+	void (*updateVec16)(const int16_t* src, int16_t* dst, const int16_t* const adds[], int addCount, const int16_t* const subs[], int subCount, size_t count);
+	void (*clamp0Vec16)(int16_t* v1, size_t count);
+	void (*convertVec32to16clamp0)(int32_t* v1, int16_t* v2, const int shift, size_t count);
+	void (*transformInt16)(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount);
+	void (*transformBlockedInt16)(const int16_t* blockedWeights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount);
+	void (*convertVec16to8clamp127)(const int16_t* v1, uint8_t* v2, const int shift, size_t count);
+	void (*transformBlockedInt8)(const int8_t* blockedWeights, const uint8_t* inputs, const int32_t* multipliers, int32_t* outputs, size_t inputCount, size_t outputCount);
+};
+
 class SIMD
 {
 public:
+	static eSimdLevel DetectCpuLevel();
+	static bool SetKernelLevel(eSimdLevel level);
+	static eSimdLevel KernelLevel() { return kernels.level; }
+	static const char* LevelName(eSimdLevel level);
+
 	// Horizontal sum (add 8 adjacently stored 32-bit integers and return that value)
 	static inline int32_t horizontalSum_8x32(__m256i v)
 	{
@@ -82,39 +118,45 @@ public:
 		assert((count & 15) == 0);
 		assert(((int64_t)v1 & 31) == 0);
 		assert(((int64_t)v2 & 31) == 0);
-		const int16_t* const v1End = v1 + count;
+		return kernels.dotProductInt16(v1, v2, count);
+	}
 
-#if defined(USE_AVX2)
-		__m256i dotSum = _mm256_setzero_si256();
-		for (; v1 < v1End; v1 += 16, v2 += 16)
-		{
-			const __m256i temp_1 = _mm256_load_si256((__m256i*)v1);	// Load the 16 values
-			const __m256i temp_2 = _mm256_load_si256((__m256i*)v2); // Load the 16 values
-			dotSum = _mm256_add_epi32(dotSum, _mm256_madd_epi16(temp_1, temp_2)); // Do the mulitply add, and add result to dotSum
-		}
+	// (16-bit) adds the dot-product of each row of weights (inputCount values per output) with inputs to outputs
+	static inline void transformInt16(const int16_t* weights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		assert((inputCount & 15) == 0);
+		assert(((int64_t)weights & 31) == 0);
+		assert(((int64_t)inputs & 31) == 0);
+		kernels.transformInt16(weights, inputs, outputs, inputCount, outputCount);
+	}
 
-		// madd16 stores in 8 32-bit values (does adjacent sums) so we have to horizontal sum those : https://software.intel.com/content/www/us/en/develop/documentation/cpp-compiler-developer-guide-and-reference/top/compiler-reference/intrinsics/intrinsics-for-intel-advanced-vector-extensions-2/intrinsics-for-arithmetic-operations-2/mm256-madd-epi16.html
-		return horizontalSum_8x32(dotSum);
-#elif defined(USE_SSE2)  
-		__m128i dotSum = _mm_setzero_si128();
-		for (; v1 < v1End; v1 += 8, v2 += 8)
-		{
-			const __m128i temp_1 = _mm_load_si128((__m128i*)v1); // Load the 8 values
-			const __m128i temp_2 = _mm_load_si128((__m128i*)v2); // Load the 8 values
-			dotSum = _mm_add_epi32(dotSum, _mm_madd_epi16(temp_1, temp_2)); // Do the mulitply add, and add result to dotSum
-		}
+	// Same as transformInt16, with the weights interleaved in blocks of kTransformBlockOutputs outputs (see NetworkTransform::OnWeightsLoaded).
+	// Each block of outputs is accumulated in vertical lanes, so there are no horizontal sums.
+	static inline bool CanBlockTransform(size_t inputCount, size_t outputCount)
+	{
+		return (outputCount % kTransformBlockOutputs) == 0 && (inputCount & 1) == 0;
+	}
 
-		// madd16 stores in 4 32-bit values (does adjacent sums) so we have to horizontal sum those : https://software.intel.com/content/www/us/en/develop/documentation/cpp-compiler-developer-guide-and-reference/top/compiler-reference/intrinsics/intrinsics-for-intel-advanced-vector-extensions-2/intrinsics-for-arithmetic-operations-2/mm256-madd-epi16.html
-		return horizontalSum_4x32(dotSum);
-#else
-		int32_t dotSum = 0;
+	static inline void transformBlockedInt16(const int16_t* blockedWeights, const int16_t* inputs, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		assert(CanBlockTransform(inputCount, outputCount));
+		assert(((int64_t)blockedWeights & 63) == 0);
+		kernels.transformBlockedInt16(blockedWeights, inputs, outputs, inputCount, outputCount);
+	}
 
-		for (; v1 < v1End; v1++, v2++)
-		{
-			dotSum += (*v1) * (*v2);
-		}
-		return dotSum;
-#endif
+	// (8-bit) Same as transformBlockedInt16 with int8 weights and uint8 inputs, interleaved 4 inputs per output (see NetworkTransform::QuantizeInt8).
+	// Each output's sum is multiplied by its multiplier (the weight scale) before it's added to the output.
+	// Inputs must be <= 127 so the pairs summed in 16-bit by maddubs can't saturate, and every level gives the same result.
+	static inline bool CanBlockTransformInt8(size_t inputCount, size_t outputCount)
+	{
+		return (outputCount % kTransformBlockOutputs) == 0 && (inputCount & 15) == 0;
+	}
+
+	static inline void transformBlockedInt8(const int8_t* blockedWeights, const uint8_t* inputs, const int32_t* multipliers, int32_t* outputs, size_t inputCount, size_t outputCount)
+	{
+		assert(CanBlockTransformInt8(inputCount, outputCount));
+		assert(((int64_t)blockedWeights & 63) == 0);
+		kernels.transformBlockedInt8(blockedWeights, inputs, multipliers, outputs, inputCount, outputCount);
 	}
 
 	static inline float dotProductFloat(const float* v1, const float* v2, size_t count)
@@ -155,28 +197,7 @@ public:
 	{
 		assert((count & 15) == 0);
 		assert(((int64_t)v1 & 31) == 0);
-		const int16_t* v1End = v1 + count;
-
-#if defined(USE_AVX2)
-		for (; v1 < v1End; v1 += 16, v2 += 16)
-		{
-			const __m256i temp1 = _mm256_load_si256((__m256i*)v1);	// Load the 16 values from v1
-			const __m256i temp2 = _mm256_load_si256((__m256i*)v2); 	// Load the 16 values from v2
-			_mm256_store_si256((__m256i*)v1, _mm256_add_epi16(temp1, temp2)); // Sum all 16 and store in v1
-		}
-#elif defined(USE_SSE2)
-		for (; v1 < v1End; v1 += 8, v2 += 8)
-		{
-			const __m128i temp1 = _mm_load_si128((__m128i*)v1);
-			const __m128i temp2 = _mm_load_si128((__m128i*)v2);
-			_mm_store_si128((__m128i*)v1, _mm_add_epi16(temp1, temp2)); // Sum all 8 and store in v1
-		}
-#else
-		for (; v1 < v1End; v1++, v2++)
-		{
-			*v1 += *v2;
-		}
-#endif
+		kernels.addVec16(v1, v2, count);
 	}
 
 	// v1 = v1 + v2
@@ -212,28 +233,15 @@ public:
 	static inline void subVec16(int16_t* v1, const int16_t* v2, size_t count)
 	{
 		assert((count & 15) == 0);
-		const int16_t* v1End = v1 + count;
+		kernels.subVec16(v1, v2, count);
+	}
 
-#if defined(USE_AVX2)
-		for (; v1 < v1End; v1 += 16, v2 += 16)
-		{
-			const __m256i temp1 = _mm256_load_si256((__m256i*)v1);	// Load the 16 values from v1
-			const __m256i temp2 = _mm256_load_si256((__m256i*)v2); 	// Load the 16 values from v2
-			_mm256_store_si256((__m256i*)v1, _mm256_sub_epi16(temp1, temp2)); // Sum all 16 and store in v1
-		}
-#elif defined(USE_SSE2)
-		for (; v1 < v1End; v1 += 8, v2 += 8)
-		{
-			const __m128i temp1 = _mm_load_si128((__m128i*)v1);
-			const __m128i temp2 = _mm_load_si128((__m128i*)v2);
-			_mm_store_si128((__m128i*)v1, _mm_sub_epi16(temp1, temp2)); // Sum all 8 and store in v1
-		}
-#else
-		for (; v1 < v1End; v1++, v2++)
-		{
-			*v1 -= *v2;
-		}
-#endif
+	// dst = src + each of adds - each of subs, in a single pass that keeps each part of dst in a register (dst can be src)
+	static inline void updateVec16(const int16_t* src, int16_t* dst, const int16_t* const adds[], int addCount, const int16_t* const subs[], int subCount, size_t count)
+	{
+		assert((count & 15) == 0);
+		assert(((int64_t)dst & 31) == 0);
+		kernels.updateVec16(src, dst, adds, addCount, subs, subCount, count);
 	}
 
 	// This is used for full transform... which isn't used right now
@@ -262,28 +270,8 @@ public:
 
 	static inline void clamp0Vec16(int16_t* v1, size_t count)
 	{
-		const int16_t* v1End = v1 + count;
-
-#if defined(USE_AVX2)
-		__m256i zero = _mm256_setzero_si256();
-		for (; v1 < v1End; v1 += 16)
-		{
-			const __m256i temp1 = _mm256_load_si256((__m256i*)v1);	// Load the 16 values from v1
-			_mm256_store_si256((__m256i*)v1, _mm256_max_epi16(temp1, zero)); // clamp to >= 0
-		}
-#elif defined(USE_SSE2)
-		__m128i zero = _mm_setzero_si128();
-		for (; v1 < v1End; v1 += 8)
-		{
-			const __m128i temp1 = _mm_load_si128((__m128i*)v1);	// Load the 8 values from v1
-			_mm_store_si128((__m128i*)v1, _mm_max_epi16(temp1, zero)); // clamp to >= 0
-		}
-#else
-		for (uint32_t o = 0; o < count; o++)
-		{
-			v1[o] = std::max(v1[o], (int16_t)0);
-		}
-#endif 
+		assert((count & 15) == 0);
+		kernels.clamp0Vec16(v1, count);
 	}
 
 	// This is not used anymore, need to check it over if used
@@ -314,38 +302,20 @@ public:
 #endif 
 	}
 
-	// Converts to 32-bit v1 to 16-bit v2, including doing a right-shift 
+	// Converts to 32-bit v1 to 16-bit v2, including doing a right-shift, and clamps to >= 0
 	static inline void convertVec32to16clamp0(int32_t* v1, int16_t* v2, const int shift, size_t count)
 	{
 		assert((count & 15) == 0);
-		const int32_t* v1End = v1 + count;
+		kernels.convertVec32to16clamp0(v1, v2, shift, count);
+	}
 
-#if defined(USE_AVX2)
-		__m256i zero = _mm256_setzero_si256();
-		for (; v1 < v1End; v1 += 16, v2 += 16)
-		{
-			__m256i a = _mm256_load_si256((__m256i*)v1); // load 16 values (32-bit)
-			__m256i b = _mm256_load_si256((__m256i*)(v1 + 8));
-			a = _mm256_srai_epi32(a, shift); // shift right 
-			b = _mm256_srai_epi32(b, shift);
-			__m256i result = _mm256_packs_epi32(a, b); // pack into 16 values (16-bit)
-			result = _mm256_permute4x64_epi64(result, 0xD8);
-			_mm256_store_si256((__m256i*)v2, _mm256_max_epi16(result, zero)); // clamp to >= 0 and write into v2
-		}
-#elif defined(USE_SSE2)
-		__m128i zero = _mm_setzero_si128();
-		for (; v1 < v1End; v1 += 8, v2 += 8)
-		{
-			__m128i a = _mm_load_si128((__m128i*)v1); // load 8 values (32-bit)
-			__m128i b = _mm_load_si128((__m128i*)(v1 + 4));
-			a = _mm_srai_epi32(a, shift); // shift right 
-			b = _mm_srai_epi32(b, shift);
-			// pack into 8 values (16-bit) in v2, and also clamp to >= 0
-			_mm_store_si128((__m128i*)v2, _mm_max_epi16(_mm_packs_epi32(a, b), zero));
-		}
-#else
-		for (; v1 < v1End; v1++, v2++)
-			*v2 = (int16_t)(*v1 >> shift);
-#endif
+	// Converts 16-bit v1 to 8-bit v2, including doing a rounded right-shift, and clamps to 0..127
+	static inline void convertVec16to8clamp127(const int16_t* v1, uint8_t* v2, const int shift, size_t count)
+	{
+		assert((count & 15) == 0);
+		kernels.convertVec16to8clamp127(v1, v2, shift, count);
 	}
+
+private:
+	static SimdKernels kernels;
 };
\ No newline at end of file
@@ -0,0 +1,1036 @@
+//
+// bench.cpp
+//
+// Search benchmarks on a fixed set of positions.
+// RunBench - single thread search of the positions to a fixed depth, the node count signature changes only with the search.
+// RunSmpSpeedupTest - compares the time to reach a fixed depth with one thread and with lazy SMP threads.
+// RunTTSizeTest - transposition table hit rate and time-to-depth for a table size.
+// RunTTStressTest - many threads reading and writing a small shared transposition table, counting corrupted reads.
+// RunNetRefreshTest - how often the first layer net values are fully recomputed, with and without the refresh cache.
+// RunEvalCacheTest - eval cache hit rate, and the net evals and search time it saves.
+// RunMultiPVBench - the cost of a MultiPV search compared to a single PV search to the same depth.
+// RunStagedMoveGenBench - how many nodes cut off on the predicted move before generating the others, and the speed gained.
+// RunEvalKernelBench - GetSumIncremental speed with each SIMD kernel set the cpu supports, runtime sized and fixed size layers.
+// RunInt8AccuracyTest - eval differences and speed of the int8 hidden layers compared to the int16 ones.
+// RunSparseLayerBench - how many first layer activations are 0, and eval and search speed with the sparse first hidden layer.
+// RunEvalBatchBench - evaluating independent positions one at a time compared to EvaluateBatch, on one thread and on many.
+// RunInputUpdateBench - incremental first layer updates with one pass per changed input compared to a single fused pass, by move type.
+//
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include <unordered_set>
+#include <chrono>
+#include <memory>
+
+#include "engine.h"
+#include "guiWindows.h"
+#include "bench.h"
+
+// Positions from engine games, covering the opening, middlegame and endgame nets
+const char* g_BenchPositions[] = {
+	"B:W21,22,23,24,25,26,27,28,29,30,31,32:B1,2,3,4,5,6,7,8,9,10,11,12.",
+	"B:W19,18,24,23,21,28,25,32,31,30,29:B4,3,2,1,7,12,10,9,16,15,13.",
+	"B:W19,18,24,23,22,21,28,27,26,25:B3,8,7,6,5,12,9,14,13,20.",
+	"B:W14,24,21,28,25,32,31,30,29:B4,3,2,1,8,7,6,5,12,22.",
+	"B:W14,19,18,23,21,28,27,25,31:B3,2,1,7,6,5,12,11,20.",
+	"B:W13,18,24,28,27,26,32,31,30,29:B4,3,2,1,7,5,12,11,9,20.",
+	"B:W13,19,23,22,26,32,31,30:B3,2,1,8,12,10,14,20.",
+	"B:W10,14,19,24,23,27:B8,7,5,12,16,20,22,K26.",
+	"B:W9,27,26,32,30:B8,11,10,14,20.",
+	"B:WK11,28,27,26,25:B12,13,20,19,18.",
+};
+const int g_NumBenchPositions = sizeof(g_BenchPositions) / sizeof(g_BenchPositions[0]);
+
+struct BenchTotals
+{
+	uint64_t nodes = 0;
+	uint64_t timeMs = 0;
+	uint64_t ttProbes = 0;
+	uint64_t ttHits = 0;
+	uint64_t ttProbeCycles = 0;
+	uint64_t netFullRefreshes = 0;
+	uint64_t netCacheRefreshes = 0;
+	uint64_t evalCacheProbes = 0;
+	uint64_t evalCacheHits = 0;
+	uint64_t netEvalCycles = 0;
+	uint64_t moveGenNodes = 0;
+	uint64_t fullMoveGens = 0;
+	uint64_t nodeSignature = 14695981039346656037ull; // FNV-1a hash of the node count of each position
+
+	int KNps() const { return (timeMs > 0) ? int(nodes / timeMs) : 0; }
+	float TTHitRate() const { return (ttProbes > 0) ? float(ttHits) / float(ttProbes) : 0.0f; }
+	float EvalCacheHitRate() const { return (evalCacheProbes > 0) ? float(evalCacheHits) / float(evalCacheProbes) : 0.0f; }
+};
+
+// Search each bench position from a cleared transposition table to a fixed depth
+static BenchTotals SearchBenchPositions(int depth)
+{
+	BenchTotals totals;
+	for (int i = 0; i < g_NumBenchPositions; i++)
+	{
+		Board board;
+		board.FromString((char*)g_BenchPositions[i]);
+		engine.NewGame(board, true);
+		engine.TTable.Clear();
+
+		const uint64_t startTimeMs = GetCurrentTimeMs();
+		ComputerMove(board, engine.searchThreadData);
+		totals.timeMs += GetCurrentTimeMs() - startTimeMs;
+		totals.nodes += engine.SearchNodes();
+		totals.nodeSignature = (totals.nodeSignature ^ engine.SearchNodes()) * 1099511628211ull;
+		totals.ttProbes += engine.searchThreadData.displayInfo.ttProbes;
+		totals.ttHits += engine.searchThreadData.displayInfo.ttHits;
+		totals.ttProbeCycles += engine.searchThreadData.displayInfo.ttProbeCycles;
+		totals.netFullRefreshes += engine.searchThreadData.displayInfo.netFullRefreshes;
+		totals.netCacheRefreshes += engine.searchThreadData.displayInfo.netCacheRefreshes;
+		totals.evalCacheProbes += engine.searchThreadData.displayInfo.evalCacheProbes;
+		totals.evalCacheHits += engine.searchThreadData.displayInfo.evalCacheHits;
+		totals.netEvalCycles += engine.searchThreadData.displayInfo.netEvalCycles;
+		totals.moveGenNodes += engine.searchThreadData.displayInfo.moveGenNodes;
+		totals.fullMoveGens += engine.searchThreadData.displayInfo.fullMoveGens;
+	}
+	return totals;
+}
+
+// Saves the engine state a benchmark changes, and sets up single thread searches to a fixed depth without the opening book.
+// Everything is restored when the guard goes out of scope. A hash file the user is keeping is closed for the benchmark,
+// so it isn't cleared, and reopened after. Nothing is changed if a search is running, check IsActive() first.
+class BenchEngineState
+{
+public:
+	explicit BenchEngineState(int depth)
+		: bActive(!engine.IsSearching())
+	{
+		if (!bActive) return;
+
+		savedLimits = engine.searchLimits;
+		savedThreads = engine.numThreads;
+		savedBookSetting = checkerBoard.useOpeningBook;
+		savedUseNetRefreshCache = engine.bUseNetRefreshCache;
+		savedUseEvalCache = engine.bUseEvalCache;
+		savedUseStagedMoveGen = engine.bUseStagedMoveGen;
+		savedBoard = engine.board;
+		savedTranscript.reset(new Transcript(engine.transcript));
+
+		savedHashFile = engine.TTable.filePath;
+		engine.CloseHashFile();
+
+		engine.searchLimits.maxDepth = depth;
+		engine.searchLimits.maxSeconds = 100000.0f;
+		engine.searchLimits.bEndHard = true;
+		engine.searchLimits.multiPV = 1;
+		engine.searchLimits.maxNodes = 0;
+		engine.bStopThinking = false;
+		checkerBoard.useOpeningBook = CB_BOOK_NONE;
+		engine.SetThreadCount(1);
+	}
+
+	~BenchEngineState()
+	{
+		if (!bActive) return;
+
+		if (savedSizeMb > 0 && !engine.TTable.SetSizeMB(savedSizeMb))
+			engine.TTable.SetSizeMB(64);
+		engine.bUseNetRefreshCache = savedUseNetRefreshCache;
+		engine.bUseEvalCache = savedUseEvalCache;
+		engine.bUseStagedMoveGen = savedUseStagedMoveGen;
+		engine.SetThreadCount(savedThreads);
+		engine.searchLimits = savedLimits;
+		checkerBoard.useOpeningBook = savedBookSetting;
+		engine.board = savedBoard;
+		engine.transcript = *savedTranscript;
+		if (!savedHashFile.empty()) { engine.OpenHashFile(savedHashFile); }
+	}
+
+	BenchEngineState(const BenchEngineState&) = delete;
+	BenchEngineState& operator=(const BenchEngineState&) = delete;
+
+	bool IsActive() const { return bActive; }
+
+	// Resize the transposition table for the benchmark, the size is restored with the rest. Returns false if it can't be allocated.
+	bool SetTTSize(int sizeMb)
+	{
+		if (savedSizeMb == 0) { savedSizeMb = engine.TTable.sizeMb; }
+		return engine.TTable.SetSizeMB(sizeMb);
+	}
+
+private:
+	const bool bActive;
+	SearchLimits savedLimits;
+	int savedThreads = 1;
+	int savedBookSetting = CB_BOOK_NONE;
+	bool savedUseNetRefreshCache = true;
+	bool savedUseEvalCache = true;
+	bool savedUseStagedMoveGen = false;
+	Board savedBoard;
+	std::unique_ptr<Transcript> savedTranscript; // too big for the stack
+	std::string savedHashFile;
+	int savedSizeMb = 0; // only set if the benchmark resized the table
+};
+
+static const char* kBenchBusyText = "Can't run a benchmark during a search\n";
+
+// The standard bench : each position searched to a fixed depth on one thread from a cleared transposition table, and
+// optionally stopped at maxNodes per position. The node counts only depend on the search, so a different node count
+// or signature means a functional change, and the same counts make the speed comparable between builds.
+// Returns the report as a string.
+std::string RunBench(int depth, uint64_t maxNodes)
+{
+	// Restores the engine state when it goes out of scope
+	BenchEngineState benchState(depth);
+	if (!benchState.IsActive()) return kBenchBusyText;
+
+	engine.searchLimits.maxNodes = maxNodes;
+
+	const BenchTotals bench = SearchBenchPositions(depth);
+
+	char limitText[64] = "";
+	if (maxNodes > 0) { snprintf(limitText, sizeof(limitText), ", at most %llu nodes each", (unsigned long long)maxNodes); }
+
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"Bench : %d positions to depth %d%s, 1 thread, %d MB hash\n"
+		"Nodes : %llu   Time : %.2fs   Speed : %d KN/s\n"
+		"Node signature : %016llx\n",
+		g_NumBenchPositions, depth, limitText, engine.TTable.sizeMb,
+		(unsigned long long)bench.nodes, bench.timeMs / 1000.0f, bench.KNps(),
+		(unsigned long long)bench.nodeSignature);
+
+	return buffer;
+}
+
+// Time-to-depth of lazy SMP compared to a single thread. Returns the report as a string.
+std::string RunSmpSpeedupTest(int numThreads, int depth)
+{
+	// Restores the engine state when it goes out of scope
+	BenchEngineState benchState(depth);
+	if (!benchState.IsActive()) return kBenchBusyText;
+
+	engine.SetThreadCount(1);
+	const BenchTotals single = SearchBenchPositions(depth);
+
+	engine.SetThreadCount(numThreads);
+	const BenchTotals smp = SearchBenchPositions(depth);
+
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"SMP test : %d positions to depth %d\n"
+		"1 thread   : %.2fs   %.2f Mn   %d KN/s\n"
+		"%d threads : %.2fs   %.2f Mn   %d KN/s\n"
+		"Time to depth speedup : %.2fx   NPS speedup : %.2fx\n",
+		g_NumBenchPositions, depth,
+		single.timeMs / 1000.0f, single.nodes / 1000000.0f, single.KNps(),
+		numThreads, smp.timeMs / 1000.0f, smp.nodes / 1000000.0f, smp.KNps(),
+		(smp.timeMs > 0) ? float(single.timeMs) / float(smp.timeMs) : 0.0f,
+		(single.KNps() > 0) ? float(smp.KNps()) / float(single.KNps()) : 0.0f);
+
+	return buffer;
+}
+
+// Single thread hit rate and time-to-depth with a given transposition table size. Returns the report as a string.
+std::string RunTTSizeTest(int sizeMb, int depth)
+{
+	// Restores the engine state when it goes out of scope
+	BenchEngineState benchState(depth);
+	if (!benchState.IsActive()) return kBenchBusyText;
+
+	BenchTotals totals;
+	const bool bAllocated = benchState.SetTTSize(sizeMb);
+	if (bAllocated) {
+		totals = SearchBenchPositions(depth);
+	}
+
+	char buffer[1024];
+	if (!bAllocated)
+	{
+		snprintf(buffer, sizeof(buffer), "TT size test : could not allocate %d MB\n", sizeMb);
+		return buffer;
+	}
+	snprintf(buffer, sizeof(buffer),
+		"TT size test : %d positions to depth %d, %d MB (%d entries per %d byte bucket)\n"
+		"Time : %.2fs   %.2f Mn   %d KN/s\n"
+		"TT hit rate : %.2f%% of %.2f M probes\n",
+		g_NumBenchPositions, depth, sizeMb, ENTRIES_PER_BUCKET, (int)sizeof(TBucket),
+		totals.timeMs / 1000.0f, totals.nodes / 1000000.0f, totals.KNps(),
+		totals.TTHitRate() * 100.0f, totals.ttProbes / 1000000.0f);
+	std::string report = buffer;
+
+#ifdef TT_PROBE_TIMING
+	snprintf(buffer, sizeof(buffer), "TT probe latency : %.1f cycles%s\n",
+		(totals.ttProbes > 0) ? double(totals.ttProbeCycles) / double(totals.ttProbes) : 0.0,
+#ifdef TT_PREFETCH
+		" (prefetched)");
+#else
+		" (no prefetch)");
+#endif
+	report += buffer;
+#endif
+
+	return report;
+}
+
+// How often the first layer net values are recomputed from scratch, with and without the per-net refresh cache.
+// Returns the report as a string.
+std::string RunNetRefreshTest(int depth)
+{
+	// Restores the engine state when it goes out of scope
+	BenchEngineState benchState(depth);
+	if (!benchState.IsActive()) return kBenchBusyText;
+
+	engine.bUseNetRefreshCache = false;
+	const BenchTotals noCache = SearchBenchPositions(depth);
+
+	engine.bUseNetRefreshCache = true;
+	const BenchTotals withCache = SearchBenchPositions(depth);
+
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"Net refresh test : %d positions to depth %d\n"
+		"No cache   : %.2fs   %.2f Mn   %d KN/s   full refreshes %llu\n"
+		"With cache : %.2fs   %.2f Mn   %d KN/s   full refreshes %llu   cache refreshes %llu\n",
+		g_NumBenchPositions, depth,
+		noCache.timeMs / 1000.0f, noCache.nodes / 1000000.0f, noCache.KNps(),
+		(unsigned long long)noCache.netFullRefreshes,
+		withCache.timeMs / 1000.0f, withCache.nodes / 1000000.0f, withCache.KNps(),
+		(unsigned long long)withCache.netFullRefreshes, (unsigned long long)withCache.netCacheRefreshes);
+
+	return buffer;
+}
+
+// Eval cache hit rate, and how many net evals and how much search time it saves. The cached evals are the same as
+// computed ones, so both searches visit the same nodes. Returns the report as a string.
+std::string RunEvalCacheTest(int depth)
+{
+	// Restores the engine state when it goes out of scope
+	BenchEngineState benchState(depth);
+	if (!benchState.IsActive()) return kBenchBusyText;
+
+	engine.bUseEvalCache = false;
+	const BenchTotals noCache = SearchBenchPositions(depth);
+
+	engine.bUseEvalCache = true;
+	const BenchTotals withCache = SearchBenchPositions(depth);
+
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"Eval cache test : %d positions to depth %d, %d entries per thread\n"
+		"No cache   : %.2fs   %.2f Mn   %d KN/s\n"
+		"With cache : %.2fs   %.2f Mn   %d KN/s\n"
+		"Hit rate : %.2f%% of %.2f M net evals   search time saved : %.1f%%\n",
+		g_NumBenchPositions, depth, kEvalCacheEntries,
+		noCache.timeMs / 1000.0f, noCache.nodes / 1000000.0f, noCache.KNps(),
+		withCache.timeMs / 1000.0f, withCache.nodes / 1000000.0f, withCache.KNps(),
+		withCache.EvalCacheHitRate() * 100.0f, withCache.evalCacheProbes / 1000000.0f,
+		(noCache.timeMs > 0) ? 100.0f * ((float)noCache.timeMs - (float)withCache.timeMs) / (float)noCache.timeMs : 0.0f);
+	std::string report = buffer;
+
+#ifdef EVAL_TIMING
+	// Without the cache every probe is a net eval, so its cycles are the net time the cache started from
+	const uint64_t netEvals = withCache.evalCacheProbes - withCache.evalCacheHits;
+	snprintf(buffer, sizeof(buffer), "Net eval time : %.0f cycles per eval   %.1f%% of the net eval time saved\n",
+		(netEvals > 0) ? double(withCache.netEvalCycles) / double(netEvals) : 0.0,
+		(noCache.netEvalCycles > 0) ? 100.0 * (1.0 - double(withCache.netEvalCycles) / double(noCache.netEvalCycles)) : 0.0);
+	report += buffer;
+#endif
+
+	return report;
+}
+
+// Nodes and time of a MultiPV search of the bench positions compared to a normal single PV search to the same depth.
+// Returns the report as a string.
+std::string RunMultiPVBench(int depth, int lineCount)
+{
+	// Restores the engine state when it goes out of scope
+	BenchEngineState benchState(depth);
+	if (!benchState.IsActive()) return kBenchBusyText;
+
+	engine.searchLimits.multiPV = 1;
+	const BenchTotals singlePV = SearchBenchPositions(depth);
+
+	engine.searchLimits.multiPV = lineCount;
+	const BenchTotals multiPV = SearchBenchPositions(depth);
+
+	// Positions with fewer legal moves than lineCount search fewer lines
+	int totalLines = 0;
+	for (int i = 0; i < g_NumBenchPositions; i++)
+	{
+		Board board;
+		board.FromString((char*)g_BenchPositions[i]);
+		MoveList moveList;
+		moveList.FindMoves(board);
+		totalLines += std::min(lineCount, moveList.numMoves);
+	}
+
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"MultiPV bench : %d positions to depth %d, %d lines (%.1f per position)\n"
+		"Single PV : %.2fs   %.2f Mn   %d KN/s\n"
+		"MultiPV   : %.2fs   %.2f Mn   %d KN/s\n"
+		"MultiPV cost : %.2fx the nodes   %.2fx the time\n",
+		g_NumBenchPositions, depth, lineCount, float(totalLines) / g_NumBenchPositions,
+		singlePV.timeMs / 1000.0f, singlePV.nodes / 1000000.0f, singlePV.KNps(),
+		multiPV.timeMs / 1000.0f, multiPV.nodes / 1000000.0f, multiPV.KNps(),
+		(singlePV.nodes > 0) ? double(multiPV.nodes) / double(singlePV.nodes) : 0.0,
+		(singlePV.timeMs > 0) ? double(multiPV.timeMs) / double(singlePV.timeMs) : 0.0);
+
+	return buffer;
+}
+
+// Searches the bench positions generating all moves up front, then with staged move generation (the predicted move
+// searched before the others are generated). The move order is the same, so both visit the same nodes.
+// Returns the report as a string.
+std::string RunStagedMoveGenBench(int depth)
+{
+	// Restores the engine state when it goes out of scope
+	BenchEngineState benchState(depth);
+	if (!benchState.IsActive()) return kBenchBusyText;
+
+	engine.bUseStagedMoveGen = false;
+	const BenchTotals full = SearchBenchPositions(depth);
+
+	engine.bUseStagedMoveGen = true;
+	const BenchTotals staged = SearchBenchPositions(depth);
+
+	const uint64_t skipped = staged.moveGenNodes - staged.fullMoveGens;
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"Staged move generation bench : %d positions to depth %d\n"
+		"All moves first : %.2fs   %.2f Mn   %d KN/s\n"
+		"Staged          : %.2fs   %.2f Mn   %d KN/s   %s\n"
+		"Full generation skipped : %.2f%% of %.2f M nodes with moves   speed gain : %.1f%%\n",
+		g_NumBenchPositions, depth,
+		full.timeMs / 1000.0f, full.nodes / 1000000.0f, full.KNps(),
+		staged.timeMs / 1000.0f, staged.nodes / 1000000.0f, staged.KNps(),
+		(staged.nodeSignature == full.nodeSignature) ? "same nodes" : "NODES DIFFER",
+		(staged.moveGenNodes > 0) ? 100.0 * double(skipped) / double(staged.moveGenNodes) : 0.0, staged.moveGenNodes / 1000000.0f,
+		(full.KNps() > 0) ? 100.0f * float(staged.KNps() - full.KNps()) / float(full.KNps()) : 0.0f);
+
+	return buffer;
+}
+
+// The stress test writes entries with data computed from the key, so any hit with different data is a corrupted entry
+struct TTStressCounts
+{
+	uint64_t writes = 0;
+	uint64_t reads = 0;
+	uint64_t hits = 0;
+	uint64_t corrupted = 0;
+};
+
+static inline uint64_t XorShift64(uint64_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static void TTStressThread(TranspositionTable& table, const std::vector<uint64_t>& keys, int threadIdx, const std::atomic<bool>& bStop, TTStressCounts& counts)
+{
+	uint64_t rng = 0x9E3779B97F4A7C15ULL * (threadIdx + 1);
+	Board board;
+
+	while (!bStop)
+	{
+		const uint64_t rand = XorShift64(rng);
+		board.hashKey = keys[(rand >> 1) % keys.size()];
+		const Move keyMove((uint32_t)board.hashKey | 1);
+		const int keyEval = (int)((board.hashKey >> 8) % 1000) - 500;
+		const int keyBoardEval = (int)((board.hashKey >> 20) % 1000) - 500;
+		const int keyDepth = (int)((board.hashKey >> 40) % 60);
+
+		TEntry* entry = table.GetEntry(board, 0);
+		if (rand & 1)
+		{
+			Move move = keyMove;
+			entry->Write(board.hashKey, -2000, 2000, move, keyEval, keyBoardEval, keyDepth, 0, 0);
+			counts.writes++;
+		}
+		else
+		{
+			Move move = NO_MOVE;
+			int value = INVALID_VAL, boardEval = INVALID_VAL;
+			counts.reads++;
+			if (entry->Read(board.hashKey, -2000, 2000, move, value, boardEval, 0, 0))
+			{
+				counts.hits++;
+				if (move != keyMove || value != keyEval || boardEval != keyBoardEval) { counts.corrupted++; }
+			}
+		}
+	}
+}
+
+// Hammer a small shared table from many threads. With LOCKLESS_TT no corrupted entries should get through.
+std::string RunTTStressTest(int numThreads, int seconds)
+{
+	TranspositionTable table;
+	table.SetSizeMB(1);
+
+	// More keys than entries, so threads are constantly replacing each others entries.
+	// Skip keys the table can't tell apart (same bucket and checksum), since those hits would look corrupted.
+	std::vector<uint64_t> keys(table.numBuckets * ENTRIES_PER_BUCKET * 4);
+	std::unordered_set<uint64_t> usedSlots;
+	uint64_t rng = 0x2545F4914F6CDD1DULL;
+	for (auto& key : keys)
+	{
+		do {
+			key = XorShift64(rng);
+		} while (!usedSlots.insert((key % table.numBuckets) << 16 | TEntry::HashChecksum(key)).second);
+	}
+
+	std::atomic<bool> bStop(false);
+	std::vector<TTStressCounts> threadCounts(numThreads);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < numThreads; i++)
+	{
+		threads.emplace_back(TTStressThread, std::ref(table), std::cref(keys), i, std::cref(bStop), std::ref(threadCounts[i]));
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	bStop = true;
+	for (auto& thread : threads) { thread.join(); }
+
+	TTStressCounts total;
+	for (auto& counts : threadCounts)
+	{
+		total.writes += counts.writes;
+		total.reads += counts.reads;
+		total.hits += counts.hits;
+		total.corrupted += counts.corrupted;
+	}
+
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"TT stress test : %d threads for %ds%s\n"
+		"Writes : %llu   Reads : %llu   Hits : %llu\n"
+		"Corrupted entries : %llu\n",
+		numThreads, seconds,
+#ifdef LOCKLESS_TT
+		" (lockless)",
+#else
+		" (no validation)",
+#endif
+		(unsigned long long)total.writes, (unsigned long long)total.reads, (unsigned long long)total.hits,
+		(unsigned long long)total.corrupted);
+
+	return buffer;
+}
+
+// Time GetSumIncremental (the hidden layers of the eval) with each SIMD kernel set the cpu supports,
+// on the bench positions and the positions after each of their moves. Returns the report as a string.
+std::string RunEvalKernelBench(int iterations)
+{
+	// Switches the kernels the search threads call through
+	if (engine.IsSearching()) return kBenchBusyText;
+
+	// Build the first layer values up front, so only the hidden layers are timed
+	struct EvalPosition { int netIdx; nnInt_t* firstLayerValues; };
+	std::vector<EvalPosition> positions;
+	for (int i = 0; i < g_NumBenchPositions; i++)
+	{
+		Board board;
+		board.FromString((char*)g_BenchPositions[i]);
+		MoveList moveList;
+		moveList.FindMoves(board);
+		for (int m = -1; m < moveList.numMoves; m++)
+		{
+			Board child = board;
+			if (m >= 0) { child.DoMove(moveList.moves[m]); }
+			if (child.Bitboards.GetCheckers() == 0) continue; // all kings doesn't use the nets
+
+			EvalPosition position;
+			position.netIdx = (int)CheckersNet::GetGamePhase(child);
+			position.firstLayerValues = AlignedAllocUtil<nnInt_t>(kMaxValuesInLayer, 64);
+			engine.evalNets[position.netIdx]->ComputeFirstLayerValues(child, position.firstLayerValues);
+			positions.push_back(position);
+		}
+	}
+
+	const eSimdLevel savedLevel = SIMD::KernelLevel();
+	const bool savedFixed = engine.evalNets[0]->bUseFixedSum;
+	const eSimdLevel cpuLevel = SIMD::DetectCpuLevel();
+	double avx2Ns = 0.0;
+	int64_t referenceChecksum = 0;
+	bool bResultsMatch = true;
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "Eval kernel bench : %d positions x %d iterations (runtime sized layers / fixed size layers)\n", (int)positions.size(), iterations);
+	std::string report = buffer;
+
+	for (int level = (int)eSimdLevel::SSE2; level <= (int)cpuLevel; level++)
+	{
+		SIMD::SetKernelLevel((eSimdLevel)level);
+
+		double nsPerEval[2];
+		for (int fixed = 0; fixed < 2; fixed++)
+		{
+			SetFixedNetworks(fixed != 0);
+
+			int64_t checksum = 0;
+			const auto startTime = std::chrono::steady_clock::now();
+			for (int iter = 0; iter < iterations; iter++)
+			{
+				for (auto& position : positions)
+				{
+					checksum += engine.evalNets[position.netIdx]->GetSumIncremental(position.firstLayerValues);
+				}
+			}
+			const double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+			nsPerEval[fixed] = elapsedNs / ((double)iterations * positions.size());
+
+			if (level == (int)eSimdLevel::SSE2 && fixed == 0) { referenceChecksum = checksum; }
+			if (checksum != referenceChecksum) { bResultsMatch = false; }
+		}
+
+		if ((eSimdLevel)level == eSimdLevel::AVX2) { avx2Ns = nsPerEval[1]; }
+
+		if ((eSimdLevel)level > eSimdLevel::AVX2 && avx2Ns > 0.0)
+			snprintf(buffer, sizeof(buffer), "%-13s : %.1f / %.1f ns/eval   %.2fx vs AVX2\n", SIMD::LevelName((eSimdLevel)level), nsPerEval[0], nsPerEval[1], avx2Ns / nsPerEval[1]);
+		else
+			snprintf(buffer, sizeof(buffer), "%-13s : %.1f / %.1f ns/eval\n", SIMD::LevelName((eSimdLevel)level), nsPerEval[0], nsPerEval[1]);
+		report += buffer;
+	}
+	report += bResultsMatch ? "Results match\n" : "Results DIFFER\n";
+
+	SetFixedNetworks(savedFixed);
+	SIMD::SetKernelLevel(savedLevel);
+	for (auto& position : positions) { AlignedFreeUtil(position.firstLayerValues); }
+
+	return report;
+}
+
+// Positions from random playouts of the bench positions, with a fixed seed so every run uses the same corpus
+static void BuildPlayoutPositions(int numPositions, std::vector<Board>& positions)
+{
+	uint32_t seed = 12345;
+	for (int game = 0; (int)positions.size() < numPositions; game++)
+	{
+		Board board;
+		board.FromString((char*)g_BenchPositions[game % g_NumBenchPositions]);
+		for (int ply = 0; ply < 200 && (int)positions.size() < numPositions; ply++)
+		{
+			MoveList moveList;
+			moveList.FindMoves(board);
+			if (moveList.numMoves == 0) break;
+
+			seed = seed * 1103515245 + 12345;
+			board.DoMove(moveList.moves[(seed >> 16) % moveList.numMoves]);
+			if (board.Bitboards.GetCheckers() != 0) { positions.push_back(board); } // all kings doesn't use the nets
+		}
+	}
+}
+
+// Compares the hidden layers with int8 weights to the int16 ones on a corpus of positions, in eval units (net sum / 3 as in EvaluateBoard).
+// Returns the report as a string.
+std::string RunInt8AccuracyTest(int numPositions)
+{
+	// Switches the live nets between int8 and int16
+	if (engine.IsSearching()) return kBenchBusyText;
+
+	std::vector<Board> boards;
+	BuildPlayoutPositions(numPositions, boards);
+
+	struct EvalPosition { int netIdx; nnInt_t* firstLayerValues; };
+	std::vector<EvalPosition> positions;
+	for (const Board& board : boards)
+	{
+		EvalPosition position;
+		position.netIdx = (int)CheckersNet::GetGamePhase(board);
+		position.firstLayerValues = AlignedAllocUtil<nnInt_t>(kMaxValuesInLayer, 64);
+		engine.evalNets[position.netIdx]->ComputeFirstLayerValues(board, position.firstLayerValues);
+		positions.push_back(position);
+	}
+
+	// Eval every position with each path, then time repeated passes over the first positions (so they stay in the cache like in a search)
+	const size_t timingPositions = std::min(positions.size(), (size_t)1000);
+	const int timingPasses = 200;
+	std::vector<int> evals[2];
+	double nsPerEval[2] = {};
+	const bool savedUseInt8 = engine.bUseInt8HiddenLayers;
+	for (int useInt8 = 0; useInt8 < 2; useInt8++)
+	{
+		SetInt8HiddenLayers(useInt8 != 0);
+		for (auto& position : positions)
+		{
+			evals[useInt8].push_back(engine.evalNets[position.netIdx]->GetSumIncremental(position.firstLayerValues) / 3);
+		}
+
+		int64_t checksum = 0;
+		const auto startTime = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < timingPasses; pass++)
+		{
+			for (size_t i = 0; i < timingPositions; i++)
+			{
+				checksum += engine.evalNets[positions[i].netIdx]->GetSumIncremental(positions[i].firstLayerValues);
+			}
+		}
+		const double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+		nsPerEval[useInt8] = (checksum != 0) ? elapsedNs / ((double)timingPasses * timingPositions) : 0.0;
+	}
+	SetInt8HiddenLayers(savedUseInt8);
+
+	// Differences per net and overall (the last row)
+	const int numNets = (int)engine.evalNets.size();
+	std::vector<double> sumDiff(numNets + 1, 0.0), sumSquaredDiff(numNets + 1, 0.0);
+	std::vector<int> maxDiff(numNets + 1, 0), count(numNets + 1, 0), signFlips(numNets + 1, 0), over10(numNets + 1, 0), int8Layers(numNets + 1, 0);
+	for (int net = 0; net < numNets; net++)
+	{
+		int8Layers[net] = engine.evalNets[net]->network.Int8LayerCount();
+		int8Layers[numNets] += int8Layers[net];
+	}
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		const int diff = abs(evals[1][i] - evals[0][i]);
+		const bool bSignFlip = (evals[0][i] > 0 && evals[1][i] < 0) || (evals[0][i] < 0 && evals[1][i] > 0);
+		for (int row : { positions[i].netIdx, numNets })
+		{
+			sumDiff[row] += diff;
+			sumSquaredDiff[row] += (double)diff * diff;
+			maxDiff[row] = std::max(maxDiff[row], diff);
+			count[row]++;
+			signFlips[row] += bSignFlip ? 1 : 0;
+			over10[row] += (diff > 10) ? 1 : 0;
+		}
+	}
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "Int8 accuracy test : %d playout positions, eval units (1 checker ~ 100)\n", (int)positions.size());
+	std::string report = buffer;
+	for (int row = 0; row <= numNets; row++)
+	{
+		if (count[row] == 0) continue;
+		const char* name = (row < numNets) ? engine.evalNets[row]->baseName.c_str() : "All";
+		snprintf(buffer, sizeof(buffer), "%-16s : %6d positions   mean diff %.2f   rms %.2f   max %d   >10 %.2f%%   sign flips %d   int8 layers %d\n",
+			name, count[row], sumDiff[row] / count[row], sqrt(sumSquaredDiff[row] / count[row]), maxDiff[row], 100.0 * over10[row] / count[row], signFlips[row], int8Layers[row]);
+		report += buffer;
+	}
+	snprintf(buffer, sizeof(buffer), "GetSumIncremental (%s) : int16 %.1f ns/eval   int8 %.1f ns/eval   %.2fx\n",
+		SIMD::LevelName(SIMD::KernelLevel()), nsPerEval[0], nsPerEval[1], (nsPerEval[1] > 0.0) ? nsPerEval[0] / nsPerEval[1] : 0.0);
+	report += buffer;
+
+	for (auto& position : positions) { AlignedFreeUtil(position.firstLayerValues); }
+
+	return report;
+}
+
+// The fraction of first layer activations (and input pairs of the next layer) that are nonzero, GetSumIncremental speed
+// with the dense and the sparse first hidden layer, and searching the bench positions to a fixed depth with each.
+// Returns the report as a string.
+std::string RunSparseLayerBench(int depth)
+{
+	// Restores the engine state when it goes out of scope
+	BenchEngineState benchState(depth);
+	if (!benchState.IsActive()) return kBenchBusyText;
+
+	std::vector<Board> boards;
+	BuildPlayoutPositions(10000, boards);
+
+	struct EvalPosition { int netIdx; nnInt_t* firstLayerValues; };
+	std::vector<EvalPosition> positions;
+	const int numNets = (int)engine.evalNets.size();
+	std::vector<double> nonzeroValues(numNets, 0.0), nonzeroPairs(numNets, 0.0);
+	std::vector<int> count(numNets, 0);
+	for (const Board& board : boards)
+	{
+		EvalPosition position;
+		position.netIdx = (int)CheckersNet::GetGamePhase(board);
+		position.firstLayerValues = AlignedAllocUtil<nnInt_t>(kMaxValuesInLayer, 64);
+		engine.evalNets[position.netIdx]->ComputeFirstLayerValues(board, position.firstLayerValues);
+		positions.push_back(position);
+
+		const int outputCount = engine.evalNets[position.netIdx]->network.GetLayer(0)->outputCount;
+		int nonzero = 0, pairs = 0;
+		for (int i = 0; i < outputCount; i += 2)
+		{
+			nonzero += (position.firstLayerValues[i] > 0) + (position.firstLayerValues[i + 1] > 0);
+			pairs += (position.firstLayerValues[i] > 0 || position.firstLayerValues[i + 1] > 0);
+		}
+		nonzeroValues[position.netIdx] += (double)nonzero / outputCount;
+		nonzeroPairs[position.netIdx] += (double)pairs / (outputCount / 2);
+		count[position.netIdx]++;
+	}
+
+	// Time repeated passes over the first positions (so they stay in the cache like in a search),
+	// alternating dense and sparse a few times and keeping the best time of each
+	const size_t timingPositions = std::min(positions.size(), (size_t)1000);
+	const int timingPasses = 100;
+	double nsPerEval[2] = { 1e9, 1e9 };
+	int64_t checksums[2] = {};
+	const bool savedSparse = engine.evalNets[0]->bSparseFirstLayer;
+	for (int round = 0; round < 10; round++)
+	{
+		for (int sparse = 0; sparse < 2; sparse++)
+		{
+			SetSparseFirstLayer(sparse != 0);
+			int64_t checksum = 0;
+			const auto startTime = std::chrono::steady_clock::now();
+			for (int pass = 0; pass < timingPasses; pass++)
+			{
+				for (size_t i = 0; i < timingPositions; i++)
+				{
+					checksum += engine.evalNets[positions[i].netIdx]->GetSumIncremental(positions[i].firstLayerValues);
+				}
+			}
+			const double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+			nsPerEval[sparse] = std::min(nsPerEval[sparse], elapsedNs / ((double)timingPasses * timingPositions));
+			checksums[sparse] = checksum;
+		}
+	}
+	for (auto& position : positions) { AlignedFreeUtil(position.firstLayerValues); }
+
+	SetSparseFirstLayer(false);
+	const BenchTotals dense = SearchBenchPositions(depth);
+	SetSparseFirstLayer(true);
+	const BenchTotals sparse = SearchBenchPositions(depth);
+
+	SetSparseFirstLayer(savedSparse);
+
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer), "Sparse first hidden layer : %d playout positions, %s kernels\n", (int)positions.size(), SIMD::LevelName(SIMD::KernelLevel()));
+	std::string report = buffer;
+	for (int net = 0; net < numNets; net++)
+	{
+		if (count[net] == 0) continue;
+		snprintf(buffer, sizeof(buffer), "%-16s : %6d positions   nonzero activations %.1f%%   nonzero input pairs %.1f%%\n",
+			engine.evalNets[net]->baseName.c_str(), count[net], 100.0 * nonzeroValues[net] / count[net], 100.0 * nonzeroPairs[net] / count[net]);
+		report += buffer;
+	}
+	snprintf(buffer, sizeof(buffer),
+		"GetSumIncremental (best of 10) : dense %.1f ns/eval   sparse %.1f ns/eval   %.2fx%s\n"
+		"Search to depth %d, dense  : %.2fs   %.2f Mn   %d KN/s\n"
+		"Search to depth %d, sparse : %.2fs   %.2f Mn   %d KN/s   %s\n",
+		nsPerEval[0], nsPerEval[1], nsPerEval[0] / nsPerEval[1], (checksums[0] == checksums[1]) ? "" : "   results DIFFER",
+		depth, dense.timeMs / 1000.0f, dense.nodes / 1000000.0f, dense.KNps(),
+		depth, sparse.timeMs / 1000.0f, sparse.nodes / 1000000.0f, sparse.KNps(), (dense.nodes == sparse.nodes) ? "same nodes" : "nodes DIFFER");
+	report += buffer;
+
+	return report;
+}
+
+static void EvalBatchThread(const Board* boards, int n, int* out, int passes)
+{
+	for (int pass = 0; pass < passes; pass++) { EvaluateBatch(boards, n, out); }
+}
+
+// Evaluating playout positions one at a time compared to EvaluateBatch, for the hidden layers alone (GetSumIncremental vs GetSumBatch)
+// and for whole evals, then EvaluateBatch split across numThreads threads. Returns the report as a string.
+std::string RunEvalBatchBench(int numPositions, int numThreads)
+{
+	// Switches the live nets between the dense and sparse first hidden layer
+	if (engine.IsSearching()) return kBenchBusyText;
+
+	std::vector<Board> boards;
+	BuildPlayoutPositions(numPositions, boards);
+	const int n = (int)boards.size();
+
+	// Hidden layers alone, from first layer values grouped by net (the way EvaluateBatch sends them)
+	const int numNets = (int)engine.evalNets.size();
+	std::vector<std::vector<nnInt_t*>> netValues(numNets);
+	for (const Board& board : boards)
+	{
+		const int netIdx = (int)CheckersNet::GetGamePhase(board);
+		nnInt_t* firstLayerValues = AlignedAllocUtil<nnInt_t>(kMaxValuesInLayer, 64);
+		engine.evalNets[netIdx]->ComputeFirstLayerValues(board, firstLayerValues);
+		netValues[netIdx].push_back(firstLayerValues);
+	}
+
+	// Dense one at a time, dense batched, and sparse one at a time (what GetSumBatch does with the sparse first hidden layer)
+	const int timingPasses = 20;
+	double hiddenNs[3] = { 1e9, 1e9, 1e9 };
+	int64_t hiddenChecksums[3] = {};
+	std::vector<int> sums(n);
+	const bool savedSparse = engine.evalNets[0]->bSparseFirstLayer;
+	for (int round = 0; round < 5; round++)
+	{
+		for (int mode = 0; mode < 3; mode++)
+		{
+			const bool batch = (mode == 1);
+			SetSparseFirstLayer(mode == 2);
+			int64_t checksum = 0;
+			const auto startTime = std::chrono::steady_clock::now();
+			for (int pass = 0; pass < timingPasses; pass++)
+			{
+				for (int net = 0; net < numNets; net++)
+				{
+					const int count = (int)netValues[net].size();
+					if (batch) {
+						engine.evalNets[net]->GetSumBatch(netValues[net].data(), count, sums.data());
+					} else {
+						for (int i = 0; i < count; i++) { sums[i] = engine.evalNets[net]->GetSumIncremental(netValues[net][i]); }
+					}
+					for (int i = 0; i < count; i++) { checksum += sums[i]; }
+				}
+			}
+			const double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+			hiddenNs[mode] = std::min(hiddenNs[mode], elapsedNs / ((double)timingPasses * n));
+			hiddenChecksums[mode] = checksum;
+		}
+	}
+	SetSparseFirstLayer(savedSparse);
+	for (auto& net : netValues) {
+		for (auto firstLayerValues : net) { AlignedFreeUtil(firstLayerValues); }
+	}
+
+	// Whole evals with the current settings, one position per call and all of them in one call
+	std::vector<int> singleEvals(n), batchEvals(n), threadEvals(n);
+	double evalNs[2] = { 1e9, 1e9 };
+	for (int round = 0; round < 5; round++)
+	{
+		for (int batch = 0; batch < 2; batch++)
+		{
+			const auto startTime = std::chrono::steady_clock::now();
+			for (int pass = 0; pass < timingPasses; pass++)
+			{
+				if (batch) {
+					EvaluateBatch(boards.data(), n, batchEvals.data());
+				} else {
+					for (int i = 0; i < n; i++) { EvaluateBatch(&boards[i], 1, &singleEvals[i]); }
+				}
+			}
+			const double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+			evalNs[batch] = std::min(evalNs[batch], elapsedNs / ((double)timingPasses * n));
+		}
+	}
+
+	// EvaluateBatch from several threads at once, each with its own share of the positions
+	const int threadPasses = timingPasses * 5;
+	std::vector<std::thread> threads;
+	const auto startTime = std::chrono::steady_clock::now();
+	for (int t = 0; t < numThreads; t++)
+	{
+		const int first = (int)((int64_t)n * t / numThreads);
+		const int last = (int)((int64_t)n * (t + 1) / numThreads);
+		threads.push_back(std::thread(EvalBatchThread, &boards[first], last - first, &threadEvals[first], threadPasses));
+	}
+	for (auto& thread : threads) { thread.join(); }
+	const double threadNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count() / ((double)threadPasses * n);
+
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"Batch evaluation : %d playout positions, batches of %d, %s kernels\n"
+		"Hidden layers (best of 5) : dense %.1f ns/eval   dense batched %.1f ns/eval   %.2fx   sparse %.1f ns/eval%s\n"
+		"Whole eval (best of 5)    : one at a time %.1f ns/eval   batched %.1f ns/eval   %.2fx%s\n"
+		"EvaluateBatch on %d threads : %.1f ns/eval   %.1f M evals/s%s\n",
+		n, kEvalBatchSize, SIMD::LevelName(SIMD::KernelLevel()),
+		hiddenNs[0], hiddenNs[1], hiddenNs[0] / hiddenNs[1], hiddenNs[2],
+		(hiddenChecksums[0] == hiddenChecksums[1] && hiddenChecksums[1] == hiddenChecksums[2]) ? "" : "   results DIFFER",
+		evalNs[0], evalNs[1], evalNs[0] / evalNs[1], (singleEvals == batchEvals) ? "" : "   results DIFFER",
+		numThreads, threadNs, 1000.0 / threadNs, (threadEvals == batchEvals) ? "" : "   results DIFFER");
+
+	return buffer;
+}
+
+// Incremental first layer updates for the moves of playout positions, grouped into quiet moves, single jumps and multi-jumps.
+// Times one add/sub pass per changed input (plus the copy from the parent values) against the single fused pass.
+// Returns the report as a string.
+std::string RunInputUpdateBench(int numPositions)
+{
+	// Switches the live nets between the two update paths
+	if (engine.IsSearching()) return kBenchBusyText;
+
+	std::vector<Board> boards;
+	BuildPlayoutPositions(numPositions, boards);
+
+	struct UpdateMove { int boardIdx; Move move; };
+	const int kGroups = 3;
+	const char* groupNames[kGroups] = { "quiet moves", "single jumps", "multi-jumps" };
+	std::vector<UpdateMove> groups[kGroups];
+	std::vector<nnInt_t*> parentValues;
+	int64_t inputChanges[kGroups] = {};
+	for (int b = 0; b < (int)boards.size(); b++)
+	{
+		Board& board = boards[b];
+		CheckersNet* net = engine.evalNets[(int)CheckersNet::GetGamePhase(board)];
+		nnInt_t* values = AlignedAllocUtil<nnInt_t>(kMaxValuesInLayer, 64);
+		net->ComputeFirstLayerValues(board, values);
+		parentValues.push_back(values);
+
+		MoveList moveList;
+		moveList.FindMoves(board);
+		for (int m = 0; m < moveList.numMoves; m++)
+		{
+			const Move move = moveList.moves[m];
+			const int group = std::min(move.JumpLen(), 2);
+			InputChanges changes;
+			net->GetMoveInputChanges(move, board, changes);
+			inputChanges[group] += changes.addCount + changes.removeCount;
+			groups[group].push_back({ b, move });
+		}
+	}
+
+	// Time repeated passes over the first moves of each group (so the values stay in the cache like in a search),
+	// alternating the two ways a few times and keeping the best time of each.
+	// The net is the one of the position the move is from, like the search (which only updates within the same net).
+	alignas(64) nnInt_t childValues[kMaxValuesInLayer];
+	alignas(64) nnInt_t fusedValues[kMaxValuesInLayer];
+	const size_t kTimingMoves = 1000;
+	const int timingPasses = 200;
+	double nsPerUpdate[kGroups][2];
+	bool bSame[kGroups];
+	const bool savedFused = engine.evalNets[0]->bFusedInputUpdates;
+	for (int group = 0; group < kGroups; group++)
+	{
+		// Every move of the group has to give all the same first layer values both ways
+		bSame[group] = true;
+		for (const UpdateMove& update : groups[group])
+		{
+			const Board& board = boards[update.boardIdx];
+			CheckersNet* net = engine.evalNets[(int)CheckersNet::GetGamePhase(board)];
+			SetFusedInputUpdates(false);
+			net->IncrementalUpdate(update.move, board, parentValues[update.boardIdx], childValues);
+			SetFusedInputUpdates(true);
+			net->IncrementalUpdate(update.move, board, parentValues[update.boardIdx], fusedValues);
+			if (memcmp(childValues, fusedValues, net->network.GetLayer(0)->outputCount * sizeof(nnInt_t)) != 0)
+			{
+				bSame[group] = false;
+				break;
+			}
+		}
+
+		// The checksum keeps the timed updates from being optimized away
+		int64_t checksums[2] = {};
+		nsPerUpdate[group][0] = nsPerUpdate[group][1] = 1e9;
+		const size_t timingMoves = std::min(groups[group].size(), kTimingMoves);
+		for (int round = 0; round < 10; round++)
+		{
+			for (int fused = 0; fused < 2; fused++)
+			{
+				SetFusedInputUpdates(fused != 0);
+				int64_t checksum = 0;
+				const auto startTime = std::chrono::steady_clock::now();
+				for (int pass = 0; pass < timingPasses; pass++)
+				{
+					for (size_t i = 0; i < timingMoves; i++)
+					{
+						const UpdateMove& update = groups[group][i];
+						const Board& board = boards[update.boardIdx];
+						engine.evalNets[(int)CheckersNet::GetGamePhase(board)]->IncrementalUpdate(update.move, board, parentValues[update.boardIdx], childValues);
+						checksum += childValues[update.move.Dst()];
+					}
+				}
+				const double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+				nsPerUpdate[group][fused] = std::min(nsPerUpdate[group][fused], elapsedNs / ((double)timingPasses * std::max<size_t>(timingMoves, 1)));
+				checksums[fused] = checksum;
+			}
+		}
+		bSame[group] = bSame[group] && (checksums[0] == checksums[1]);
+	}
+	SetFusedInputUpdates(savedFused);
+	for (auto values : parentValues) { AlignedFreeUtil(values); }
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer), "Incremental input updates : %d playout positions, %s kernels\n", (int)boards.size(), SIMD::LevelName(SIMD::KernelLevel()));
+	std::string report = buffer;
+	for (int group = 0; group < kGroups; group++)
+	{
+		if (groups[group].empty()) continue;
+		snprintf(buffer, sizeof(buffer), "%-12s : %7d moves   %.1f inputs changed   (best of 10) pass per input %.1f ns   fused %.1f ns   %.2fx%s\n",
+			groupNames[group], (int)groups[group].size(), (double)inputChanges[group] / groups[group].size(),
+			nsPerUpdate[group][0], nsPerUpdate[group][1], nsPerUpdate[group][0] / nsPerUpdate[group][1], bSame[group] ? "" : "   results DIFFER");
+		report += buffer;
+	}
+
+	return report;
+}
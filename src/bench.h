@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Fixed set of positions used for benchmarking and testing the search
+extern const char* g_BenchPositions[];
+extern const int g_NumBenchPositions;
+
+std::string RunBench(int depth, uint64_t maxNodes);
+std::string RunSmpSpeedupTest(int numThreads, int depth);
+std::string RunTTSizeTest(int sizeMb, int depth);
+std::string RunTTStressTest(int numThreads, int seconds);
+std::string RunNetRefreshTest(int depth);
+std::string RunEvalCacheTest(int depth);
+std::string RunMultiPVBench(int depth, int lineCount);
+std::string RunStagedMoveGenBench(int depth);
+std::string RunEvalKernelBench(int iterations);
+std::string RunInt8AccuracyTest(int numPositions);
+std::string RunSparseLayerBench(int depth);
+std::string RunEvalBatchBench(int numPositions, int numThreads);
+std::string RunInputUpdateBench(int numPositions);
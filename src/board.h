@@ -68,8 +68,9 @@ struct Board
 	void SetFlags();
 	uint64_t CalcHashKey();
 
-	int EvaluateBoard( int ply, struct SearchThreadData& search, const struct EvalNetInfo& netInfo, int depth) const;
+	int EvaluateBoard( int ply, struct SearchThreadData& search, int depth) const;
 	int AllKingsEval() const;
+	int NetEval(int netSum) const;
 	int dbWinEval(int dbresult) const;
 
 	std::string ToString();
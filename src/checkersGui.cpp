@@ -6,6 +6,8 @@
 #include "checkersGui.h"
 #include "kr_db.h"
 #include "learning.h"
+#include "bench.h"
+#include "perft.h"
 
 CheckersGUI GUI;
 
@@ -32,7 +34,8 @@ void CheckersGUI::LoadPieceBitmaps(HINSTANCE inst)
 }
 
 // MENUS
-enum { MENU_IMPORT_MATCHES, MENU_EXPORT_TRAINING, MENU_SAVE_BINARY_NETS };
+enum { MENU_IMPORT_MATCHES, MENU_EXPORT_TRAINING, MENU_SAVE_BINARY_NETS, MENU_SMP_TEST, MENU_TT_SIZE_TEST, MENU_TT_STRESS_TEST, MENU_OPEN_HASH_FILE, MENU_SAVE_HASH_FILE, MENU_CLOSE_HASH_FILE, MENU_NET_REFRESH_TEST, MENU_EVAL_KERNEL_BENCH, MENU_INT8_ACCURACY_TEST, MENU_TOGGLE_INT8, MENU_SPARSE_LAYER_BENCH, MENU_EVAL_BATCH_BENCH, MENU_INPUT_UPDATE_BENCH, MENU_EVAL_CACHE_TEST, MENU_TOGGLE_MULTI_PV, MENU_MULTI_PV_BENCH, MENU_BENCH, MENU_PERFT, MENU_PERFT_TEST, MENU_STAGED_MOVEGEN_BENCH };
+const char* kHashFileName = "analysis.gtt";
 
 void CheckersGUI::InitMenuItems( HMENU menu )
 {
@@ -41,6 +44,26 @@ void CheckersGUI::InitMenuItems( HMENU menu )
 	AddMenuItem(subMenu, MENU_IMPORT_MATCHES, "Import Matches");
 	AddMenuItem(subMenu, MENU_EXPORT_TRAINING, "Export Training Sets");
 	AddMenuItem(subMenu, MENU_SAVE_BINARY_NETS, "Save Binary Nets");
+	AddMenuItem(subMenu, MENU_SMP_TEST, "Lazy SMP Speedup Test");
+	AddMenuItem(subMenu, MENU_TT_SIZE_TEST, "TT Hit Rate Test");
+	AddMenuItem(subMenu, MENU_TT_STRESS_TEST, "TT Stress Test");
+	AddMenuItem(subMenu, MENU_OPEN_HASH_FILE, "Open Hash File");
+	AddMenuItem(subMenu, MENU_SAVE_HASH_FILE, "Save Hash File");
+	AddMenuItem(subMenu, MENU_CLOSE_HASH_FILE, "Close Hash File");
+	AddMenuItem(subMenu, MENU_NET_REFRESH_TEST, "Net Refresh Cache Test");
+	AddMenuItem(subMenu, MENU_EVAL_KERNEL_BENCH, "Eval Kernel Benchmark");
+	AddMenuItem(subMenu, MENU_INT8_ACCURACY_TEST, "Int8 Net Accuracy Test");
+	AddMenuItem(subMenu, MENU_TOGGLE_INT8, "Toggle Int8 Hidden Layer");
+	AddMenuItem(subMenu, MENU_SPARSE_LAYER_BENCH, "Sparse First Layer Benchmark");
+	AddMenuItem(subMenu, MENU_EVAL_BATCH_BENCH, "Batch Eval Benchmark");
+	AddMenuItem(subMenu, MENU_INPUT_UPDATE_BENCH, "Input Update Benchmark");
+	AddMenuItem(subMenu, MENU_EVAL_CACHE_TEST, "Eval Cache Test");
+	AddMenuItem(subMenu, MENU_TOGGLE_MULTI_PV, "Toggle MultiPV Analysis");
+	AddMenuItem(subMenu, MENU_MULTI_PV_BENCH, "MultiPV Benchmark");
+	AddMenuItem(subMenu, MENU_BENCH, "Bench");
+	AddMenuItem(subMenu, MENU_PERFT, "Perft Current Position");
+	AddMenuItem(subMenu, MENU_PERFT_TEST, "Perft Test");
+	AddMenuItem(subMenu, MENU_STAGED_MOVEGEN_BENCH, "Staged Move Generation Benchmark");
 }
 
 void CheckersGUI::ProcessMenuCommand(WORD cmd, HWND hwnd)
@@ -50,10 +73,16 @@ void CheckersGUI::ProcessMenuCommand(WORD cmd, HWND hwnd)
 	switch (customCmd)
 	{
 	case MENU_SAVE_BINARY_NETS:
-		SaveBinaryNets( engine.binaryNetFile.c_str() );
-		snprintf(tempBuf, sizeof(tempBuf), "Saved Binary Nets to \"%s\"", engine.binaryNetFile.c_str());
+	{
+		// The shared first layer nets have their own file, so they don't overwrite the separate nets used as the fallback
+		const std::string& netFile = UsingSharedFirstLayer() ? engine.sharedBinaryNetFile : engine.binaryNetFile;
+		if (SaveBinaryNets( netFile.c_str() ))
+			snprintf(tempBuf, sizeof(tempBuf), "Saved Binary Nets to \"%s\"", netFile.c_str());
+		else
+			snprintf(tempBuf, sizeof(tempBuf), "Couldn't save Binary Nets to \"%s\"", netFile.c_str());
 		DisplayText(tempBuf);
 		break;
+	}
 
 	case MENU_EXPORT_TRAINING:
 		DisplayText("Exporting training Sets...");
@@ -71,6 +100,141 @@ void CheckersGUI::ProcessMenuCommand(WORD cmd, HWND hwnd)
 		DisplayText(buffer);
 		break;
 	}
+
+	case MENU_SMP_TEST:
+	{
+		DisplayText("Running Lazy SMP speedup test...");
+		const int numThreads = std::max(2, (int)std::thread::hardware_concurrency());
+		DisplayText(RunSmpSpeedupTest(numThreads, 19).c_str());
+		break;
+	}
+
+	case MENU_TT_SIZE_TEST:
+	{
+		DisplayText("Running transposition table hit rate test...");
+		DisplayText(RunTTSizeTest(engine.TTable.sizeMb, 21).c_str());
+		break;
+	}
+
+	case MENU_TT_STRESS_TEST:
+	{
+		DisplayText("Running transposition table stress test...");
+		const int numThreads = std::max(2, (int)std::thread::hardware_concurrency());
+		DisplayText(RunTTStressTest(numThreads, 10).c_str());
+		break;
+	}
+
+	case MENU_OPEN_HASH_FILE:
+		DisplayText(engine.OpenHashFile(kHashFileName).c_str());
+		break;
+
+	case MENU_SAVE_HASH_FILE:
+		engine.SaveHashFile();
+		DisplayText(engine.TTable.IsFileMapped() ? "Saved Hash File" : "No Hash File open");
+		break;
+
+	case MENU_CLOSE_HASH_FILE:
+		DisplayText(engine.CloseHashFile().c_str());
+		break;
+
+	case MENU_NET_REFRESH_TEST:
+	{
+		DisplayText("Running net refresh cache test...");
+		DisplayText(RunNetRefreshTest(19).c_str());
+		break;
+	}
+
+	case MENU_EVAL_KERNEL_BENCH:
+	{
+		DisplayText("Running eval kernel benchmark...");
+		DisplayText(RunEvalKernelBench(20000).c_str());
+		break;
+	}
+
+	case MENU_INT8_ACCURACY_TEST:
+	{
+		DisplayText("Running int8 accuracy test...");
+		DisplayText(RunInt8AccuracyTest(100000).c_str());
+		break;
+	}
+
+	case MENU_TOGGLE_INT8:
+		if (engine.IsSearching()) {
+			DisplayText("Can't change int8 during a search");
+			break;
+		}
+		SetInt8HiddenLayers(!engine.bUseInt8HiddenLayers);
+		DisplayText(engine.bUseInt8HiddenLayers ? "Using int8 hidden layer" : "Using int16 hidden layers");
+		break;
+
+	case MENU_SPARSE_LAYER_BENCH:
+	{
+		DisplayText("Running sparse first layer benchmark...");
+		DisplayText(RunSparseLayerBench(19).c_str());
+		break;
+	}
+
+	case MENU_EVAL_BATCH_BENCH:
+	{
+		DisplayText("Running batch eval benchmark...");
+		DisplayText(RunEvalBatchBench(100000, std::max(1, (int)std::thread::hardware_concurrency())).c_str());
+		break;
+	}
+
+	case MENU_INPUT_UPDATE_BENCH:
+	{
+		DisplayText("Running input update benchmark...");
+		DisplayText(RunInputUpdateBench(100000).c_str());
+		break;
+	}
+
+	case MENU_EVAL_CACHE_TEST:
+	{
+		DisplayText("Running eval cache test...");
+		DisplayText(RunEvalCacheTest(19).c_str());
+		break;
+	}
+
+	case MENU_TOGGLE_MULTI_PV:
+		// Analysis ranks every root move
+		engine.searchLimits.multiPV = (engine.searchLimits.multiPV > 1) ? 1 : MoveList::MAX_MOVES;
+		DisplayText((engine.searchLimits.multiPV > 1) ? "MultiPV on : searching every root move" : "MultiPV off");
+		break;
+
+	case MENU_MULTI_PV_BENCH:
+	{
+		DisplayText("Running MultiPV benchmark...");
+		DisplayText(RunMultiPVBench(17, 4).c_str());
+		break;
+	}
+
+	case MENU_BENCH:
+	{
+		DisplayText("Running bench...");
+		DisplayText(RunBench(17, 0).c_str());
+		break;
+	}
+
+	case MENU_PERFT:
+	{
+		DisplayText("Running perft...");
+		DisplayText(RunPerft(engine.board, 10, std::max(1, (int)std::thread::hardware_concurrency()), 64).c_str());
+		break;
+	}
+
+	case MENU_PERFT_TEST:
+	{
+		DisplayText("Running perft test...");
+		DisplayText(RunPerftTest(11, std::max(1, (int)std::thread::hardware_concurrency())).c_str());
+		break;
+	}
+
+	case MENU_STAGED_MOVEGEN_BENCH:
+	{
+		DisplayText("Running staged move generation benchmark...");
+		DisplayText(RunStagedMoveGenBench(17).c_str());
+		break;
+	}
 		default: break;
 	}
 
@@ -125,8 +289,10 @@ void CheckersGUI::get_eval_string(const Board& board, std::string &evalstr)
 {
 	EvalNetInfo &netInfo = engine.searchThreadData.stack->netInfo; 
 	netInfo.netIdx = (int)CheckersNet::GetGamePhase(board);
-	engine.evalNets[netInfo.netIdx]->ComputeFirstLayerValues(board, engine.searchThreadData.nnValues, netInfo.firstLayerValues);
-	int eval = board.EvaluateBoard(0, engine.searchThreadData, netInfo, 100);
+	netInfo.firstLayerIdx = engine.evalNets[netInfo.netIdx]->firstLayerIdx;
+	engine.evalNets[netInfo.netIdx]->ComputeFirstLayerValues(board, netInfo.firstLayerValues);
+	netInfo.bValuesComputed = true;
+	int eval = board.EvaluateBoard(0, engine.searchThreadData, 100);
 	if (board.sideToMove == WHITE)
 		eval = -eval;			/* Make it + strong for black. */
 
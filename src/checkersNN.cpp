@@ -4,69 +4,340 @@
 //
 // Neural nets for checkers evaluation.
 // We're using a 4 different relatively small nets for each for its own game stage.
+// Optionally the 4 nets share one wider first layer, so only the hidden layers differ by game stage.
 // For learning the exporter automatically exports the labeled training position to the proper net.
 //
 
 #include <string.h>
 #include <sstream>  
+#include <chrono>
+#include <memory>
 
 #include "neuralNet/NeuralNet.h"
+#include "neuralNet/FixedNetwork.h"
+#include "neuralNet/MappedFile.h"
 #include "engine.h"
 
-int InitializeNeuralNets()
+// Create the eval nets, either each with its own first layer, or with one first layer shared by all the game phase nets
+static void CreateEvalNets(bool bSharedFirstLayer)
 {
-	auto testNet = new CheckersNet("Test", 128, eGamePhase::EARLY);
+	for (auto net : engine.evalNets) { delete net; }
+	engine.evalNets.clear();
+
 	// Note : the enum values need to be in order for netIdx = (int)CheckersNet::GetGamePhase(board);
-	engine.evalNets.push_back(new CheckersNet("CheckersEarly", 224, eGamePhase::EARLY));
-	engine.evalNets.push_back(new CheckersNet("CheckersMid", 224, eGamePhase::MID));
-	engine.evalNets.push_back(new CheckersNet("CheckersEnd", 192, eGamePhase::END));
-	engine.evalNets.push_back(new CheckersNet("CheckersLateEnd", 192, eGamePhase::LATE_END));
+	if (bSharedFirstLayer)
+	{
+		engine.evalNets.push_back(new CheckersNet("CheckersSharedEarly", kSharedFirstLayerNeurons, eGamePhase::EARLY));
+		engine.evalNets.push_back(new CheckersNet("CheckersSharedMid", kSharedFirstLayerNeurons, eGamePhase::MID));
+		engine.evalNets.push_back(new CheckersNet("CheckersSharedEnd", kSharedFirstLayerNeurons, eGamePhase::END));
+		engine.evalNets.push_back(new CheckersNet("CheckersSharedLateEnd", kSharedFirstLayerNeurons, eGamePhase::LATE_END));
+	}
+	else
+	{
+		engine.evalNets.push_back(new CheckersNet("CheckersEarly", 224, eGamePhase::EARLY));
+		engine.evalNets.push_back(new CheckersNet("CheckersMid", 224, eGamePhase::MID));
+		engine.evalNets.push_back(new CheckersNet("CheckersEnd", 192, eGamePhase::END));
+		engine.evalNets.push_back(new CheckersNet("CheckersLateEnd", 192, eGamePhase::LATE_END));
+	}
 
-	// Init the structure and load the networks 
+	for (int i = 0; i < (int)engine.evalNets.size(); i++)
+	{
+		engine.evalNets[i]->firstLayerIdx = bSharedFirstLayer ? 0 : i;
+		engine.evalNets[i]->InitNetwork();
+	}
+}
+
+// Point the nets that share a first layer at the owner's weights, after the owner's are loaded
+static void ShareFirstLayers()
+{
+	for (int i = 0; i < (int)engine.evalNets.size(); i++)
+	{
+		CheckersNet* net = engine.evalNets[i];
+		if (net->firstLayerIdx != i) net->network.ShareFirstLayer(engine.evalNets[net->firstLayerIdx]->network);
+	}
+}
+
+static int LoadEvalNets(const std::string& binaryNetFile)
+{
 	int numLoaded = 0;
 	for (auto net : engine.evalNets ) 
 	{
-		net->InitNetwork();
 		net->isLoaded = net->network.LoadText(net->neuralNetFile.c_str());
 		numLoaded += net->isLoaded ? 1 : 0;
 	}
 
 	// If nothing loaded, load nets from binary data instead. The released version won't have the development text nets.
 	if (numLoaded == 0) {
-		numLoaded = LoadBinaryNets( (std::string("engines/") + engine.binaryNetFile).c_str() );
-		if (numLoaded == 0 ) numLoaded = LoadBinaryNets(engine.binaryNetFile.c_str());
+		numLoaded = LoadBinaryNets( (std::string("engines/") + binaryNetFile).c_str() );
+		if (numLoaded == 0 ) numLoaded = LoadBinaryNets(binaryNetFile.c_str());
 	}
+	ShareFirstLayers();
+	return numLoaded;
+}
+
+int InitializeNeuralNets()
+{
+	auto testNet = new CheckersNet("Test", 128, eGamePhase::EARLY);
+
+	// The nets with a shared first layer are optional, use them when all of them have been trained
+	CreateEvalNets(true);
+	int numLoaded = LoadEvalNets(engine.sharedBinaryNetFile);
+	if (numLoaded < (int)engine.evalNets.size())
+	{
+		CreateEvalNets(false);
+		numLoaded = LoadEvalNets(engine.binaryNetFile);
+	}
+	SetInt8HiddenLayers(engine.bUseInt8HiddenLayers);
 
 	return numLoaded;
 }
 
-// Load and Save nets from a single binary file
+bool UsingSharedFirstLayer()
+{
+	return engine.evalNets.size() > 1 && engine.evalNets[1]->firstLayerIdx == 0;
+}
+
+// Nets that share their first layer only store their hidden layers, the shared layer is stored once with its owner
+static uint32_t StoredFirstTransform(int netIdx)
+{
+	return (engine.evalNets[netIdx]->firstLayerIdx != netIdx) ? 1 : 0;
+}
+
+static const char kMappedNetsMagic[8] = "GUINNET";
+static std::unique_ptr<MappedFile> mappedNetFile; // the file the nets are using in place, if any
+static std::string mappedNetPath;
+
+static void FillMappedNetsFileHeader(MappedNetsFileHeader& header)
+{
+	memset(&header, 0, sizeof(MappedNetsFileHeader));
+	memcpy(header.magic, kMappedNetsMagic, sizeof(kMappedNetsMagic));
+	header.fileVersion = kMappedNetsVersion;
+	header.weightBytes = sizeof(nnInt_t);
+	header.fixedShift = kFixedShift;
+	header.blockOutputs = kTransformBlockOutputs;
+	header.int8ActivationShift = kInt8ActivationShift;
+	header.maxValuesInLayer = kMaxValuesInLayer;
+	header.netCount = (uint32_t)engine.evalNets.size();
+}
+
+// FNV-1a on 64-bit words, the net data is all 64-byte aligned
+static uint64_t MappedNetsChecksum(const uint8_t* data, size_t bytes)
+{
+	uint64_t checksum = 0xCBF29CE484222325ULL;
+	const uint64_t* words = (const uint64_t*)data;
+	for (size_t i = 0; i < bytes / sizeof(uint64_t); i++)
+		checksum = (checksum ^ words[i]) * 0x100000001B3ULL;
+	return checksum;
+}
+
+// Use a mapped net file in place. Returns the number of nets loaded, 0 if it isn't a mapped net file that matches the nets.
+static int LoadMappedNets(const char* filename)
+{
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->Open(filename) || file->Size() < sizeof(MappedNetsFileHeader)) return 0;
+
+	MappedNetsFileHeader expected;
+	FillMappedNetsFileHeader(expected);
+	expected.fileBytes = file->Size();
+	const MappedNetsFileHeader& header = *(const MappedNetsFileHeader*)file->Data();
+	expected.checksum = header.checksum;
+	if (memcmp(&header, &expected, sizeof(MappedNetsFileHeader)) != 0) return 0;
+	if (MappedNetsChecksum(file->Data() + sizeof(MappedNetsFileHeader), file->Size() - sizeof(MappedNetsFileHeader)) != header.checksum) return 0;
+
+	// Check every net before pointing any of them at the file
+	std::vector<const uint8_t*> netData;
+	size_t offset = sizeof(MappedNetsFileHeader);
+	for (int i = 0; i < (int)engine.evalNets.size(); i++)
+	{
+		const MappedNetHeader& netHeader = *(const MappedNetHeader*)(file->Data() + offset);
+		if (!engine.evalNets[i]->network.MatchesMapped(netHeader, file->Size() - offset, StoredFirstTransform(i))) return 0;
+		netData.push_back(file->Data() + offset);
+		offset += netHeader.netBytes;
+	}
+
+	for (int i = 0; i < (int)engine.evalNets.size(); i++)
+	{
+		engine.evalNets[i]->network.UseMapped(netData[i]);
+		engine.evalNets[i]->isLoaded = true;
+	}
+	mappedNetFile = std::move(file); // unmaps the previous file, which no net uses now
+	mappedNetPath = filename;
+	return (int)engine.evalNets.size();
+}
+
+// Load and Save nets from a single binary file.
+// Files in the mapped format are used in place, the older files with just the weights of each net are read in.
 int LoadBinaryNets(const char* filename)
 {
-	int validNets = 0;
-	FILE* fp = fopen(filename, "rb");
-	if (fp)
+	int validNets = LoadMappedNets(filename);
+	if (validNets == 0)
 	{
-		for (auto net : engine.evalNets)
+		FILE* fp = fopen(filename, "rb");
+		if (fp)
 		{
-			net->isLoaded = net->network.ReadNet(fp);
-			validNets += net->isLoaded ? 1 : 0;
+			for (int i = 0; i < (int)engine.evalNets.size(); i++)
+			{
+				CheckersNet* net = engine.evalNets[i];
+				net->isLoaded = net->network.ReadNet(fp, StoredFirstTransform(i));
+				validNets += net->isLoaded ? 1 : 0;
+			}
+			fclose(fp);
 		}
-		fclose(fp);
 	}
+	ShareFirstLayers();
 	return validNets;
 }
 
-void SaveBinaryNets( const char *filename )
+// Saves in the mapped format. Returns false if the file couldn't be written, which includes the file the nets are mapped from.
+// The size of the file written is returned in fileBytes if it's given.
+bool SaveBinaryNets( const char *filename, uint64_t* fileBytes )
 {
-	FILE* fp = fopen(filename, "wb");
-	if (fp)
+	if (mappedNetFile && mappedNetFile->IsOpen() && mappedNetPath == filename) return false;
+
+	FILE* fp = fopen(filename, "w+b");
+	if (!fp) return false;
+
+	MappedNetsFileHeader header;
+	FillMappedNetsFileHeader(header);
+	fwrite(&header, sizeof(header), 1, fp);
+	for (int i = 0; i < (int)engine.evalNets.size(); i++)
 	{
-		for (auto net : engine.evalNets)
-		{
-			net->network.WriteNet(fp);
+		engine.evalNets[i]->network.WriteMapped(fp, StoredFirstTransform(i));
+	}
+
+	// Now the size is known, and the checksum can be computed from what was written
+	header.fileBytes = (uint64_t)ftell(fp);
+	std::vector<uint8_t> data((size_t)header.fileBytes - sizeof(header));
+	fseek(fp, sizeof(header), SEEK_SET);
+	const bool bRead = fread(data.data(), 1, data.size(), fp) == data.size();
+	header.checksum = MappedNetsChecksum(data.data(), data.size());
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, fp);
+	if (fileBytes) { *fileBytes = header.fileBytes; }
+	return (fclose(fp) == 0) && bRead;
+}
+
+static std::string ConvertNets(const char* inFilename, const char* outFilename)
+{
+	std::stringstream ss;
+	auto startTime = std::chrono::steady_clock::now();
+	const int numLoaded = LoadBinaryNets(inFilename);
+	const double inLoadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	if (numLoaded < (int)engine.evalNets.size())
+	{
+		ss << "Couldn't load the nets from \"" << inFilename << "\" (" << numLoaded << " of " << engine.evalNets.size() << " nets)\n";
+		return ss.str();
+	}
+	uint64_t outBytes = 0;
+	if (!SaveBinaryNets(outFilename, &outBytes))
+	{
+		ss << "Couldn't write \"" << outFilename << "\"\n";
+		return ss.str();
+	}
+
+	startTime = std::chrono::steady_clock::now();
+	const int numMapped = LoadMappedNets(outFilename);
+	const double outLoadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	ShareFirstLayers();
+
+	ss.setf(std::ios::fixed);
+	ss.precision(3);
+	ss << "Converted " << numLoaded << " nets from \"" << inFilename << "\" to \"" << outFilename << "\" (version " << kMappedNetsVersion << ", " << outBytes << " bytes)\n";
+	ss << "Load time : " << inFilename << " " << inLoadMs << " ms,  " << outFilename << " " << outLoadMs << " ms" << (numMapped ? " (mapped)" : " (map failed)") << "\n";
+	return ss.str();
+}
+
+// Convert a net file (either format) to the mapped format, and compare how long each takes to load.
+// The engine goes back to its own nets after. Not while searching, since the net weights are replaced.
+std::string ConvertBinaryNets(const char* inFilename, const char* outFilename)
+{
+	std::string report = ConvertNets(inFilename, outFilename);
+
+	const int numLoaded = LoadEvalNets(UsingSharedFirstLayer() ? engine.sharedBinaryNetFile : engine.binaryNetFile);
+	SetInt8HiddenLayers(engine.bUseInt8HiddenLayers);
+	if (numLoaded < (int)engine.evalNets.size())
+		report += "Couldn't reload the engine's nets, the nets from \"" + std::string(inFilename) + "\" are still in use\n";
+	return report;
+}
+
+// Switch the eval nets between the int16 and int8 quantized hidden layers
+void SetInt8HiddenLayers(bool bUse)
+{
+	engine.bUseInt8HiddenLayers = bUse;
+	for (auto net : engine.evalNets) { net->network.SetUseInt8(bUse); }
+}
+
+void SetFixedNetworks(bool bUse)
+{
+	for (auto net : engine.evalNets) { net->bUseFixedSum = bUse; }
+}
+
+void SetSparseFirstLayer(bool bSparse)
+{
+	for (auto net : engine.evalNets) { net->bSparseFirstLayer = bSparse; }
+}
+
+void SetFusedInputUpdates(bool bFused)
+{
+	for (auto net : engine.evalNets) { net->bFusedInputUpdates = bFused; }
+}
+
+// Positions waiting for their net to have a full batch
+struct EvalBatchPending
+{
+	alignas(64) nnInt_t firstLayerValues[kEvalBatchSize][kMaxValuesInLayer];
+	const Board* boards[kEvalBatchSize];
+	int outIdx[kEvalBatchSize];
+	int count = 0;
+};
+
+static void FlushEvalBatch(const CheckersNet& net, EvalBatchPending& pending, int out[])
+{
+	const nnInt_t* firstLayerValues[kEvalBatchSize];
+	int sums[kEvalBatchSize];
+	for (int i = 0; i < pending.count; i++) { firstLayerValues[i] = pending.firstLayerValues[i]; }
+
+	net.GetSumBatch(firstLayerValues, pending.count, sums);
+
+	for (int i = 0; i < pending.count; i++) {
+		const Board& board = *pending.boards[i];
+		out[pending.outIdx[i]] = to_rel_score(board.NetEval(sums[i]), board.sideToMove);
+	}
+	pending.count = 0;
+}
+
+// Evaluates n independent boards (relative to each board's side to move, like EvaluateBoard at ply 0).
+// The boards for each net are summed kEvalBatchSize at a time so the hidden layers share the weight loads.
+// The endgame databases aren't probed. All the scratch values are local so this can be called from multiple threads.
+void EvaluateBatch(const Board* boards, int n, int* out)
+{
+	EvalBatchPending pending[kMaxEvalNets];
+
+	for (int i = 0; i < n; i++)
+	{
+		const Board& board = boards[i];
+		if (board.numPieces[board.sideToMove] == 0) {
+			out[i] = -WinScore(0);
+			continue;
+		}
+		if (board.Bitboards.GetCheckers() == 0) {
+			out[i] = to_rel_score(board.AllKingsEval(), board.sideToMove);
+			continue;
 		}
-		fclose(fp);
+
+		const int netIdx = (int)CheckersNet::GetGamePhase(board);
+		const CheckersNet& net = *engine.evalNets[netIdx];
+		EvalBatchPending& netPending = pending[netIdx];
+		net.ComputeFirstLayerValues(board, netPending.firstLayerValues[netPending.count]);
+		netPending.boards[netPending.count] = &board;
+		netPending.outIdx[netPending.count] = i;
+		if (++netPending.count == kEvalBatchSize) {
+			FlushEvalBatch(net, netPending, out);
+		}
+	}
+
+	for (int netIdx = 0; netIdx < kMaxEvalNets; netIdx++) {
+		if (pending[netIdx].count > 0) FlushEvalBatch(*engine.evalNets[netIdx], pending[netIdx], out);
 	}
 }
 
@@ -82,6 +353,20 @@ void CheckersNet::InitNetwork()
 	network.AddLayer(32, eActivation::RELU);
 	network.AddLayer(1);
 	network.Build();
+
+	// Use the hidden layers compiled for these layer sizes when there's a match, otherwise the runtime sized ones
+	if (FixedNetwork<224, 32, 32>::Matches(network)) {
+		fixedHiddenSum = FixedNetwork<224, 32, 32>::SumHiddenLayers;
+		fixedHiddenSumBatch = FixedNetwork<224, 32, 32>::SumHiddenLayersBatch;
+	}
+	if (FixedNetwork<192, 32, 32>::Matches(network)) {
+		fixedHiddenSum = FixedNetwork<192, 32, 32>::SumHiddenLayers;
+		fixedHiddenSumBatch = FixedNetwork<192, 32, 32>::SumHiddenLayersBatch;
+	}
+	if (FixedNetwork<kSharedFirstLayerNeurons, 32, 32>::Matches(network)) {
+		fixedHiddenSum = FixedNetwork<kSharedFirstLayerNeurons, 32, 32>::SumHiddenLayers;
+		fixedHiddenSumBatch = FixedNetwork<kSharedFirstLayerNeurons, 32, 32>::SumHiddenLayersBatch;
+	}
 }
 
 eGamePhase CheckersNet::GetGamePhase(const Board& board)
@@ -101,36 +386,23 @@ bool CheckersNet::IsActive(const Board& board) const
 	return (GetGamePhase(board) == gamePhase);
 }
 
-void CheckersNet::ConvertToInputValues(const Board& board, nnInt_t Values[]) const
+// The active inputs straight from the bitboards : a piece type on each occupied square, and black to move
+int CheckersNet::GetActiveInputs(const Board& board, int activeInputs[kMaxActiveInputs]) const
 {
-	const NetworkTransform<nnInt_t>* transform = network.GetTransform(0);
-	nnInt_t* Inputs = Values;
-	nnInt_t* Outputs = network.GetLayerOutputValues(0, Values);
-
-	// Clear inputs and set outputs to biases
-	memset(Inputs, 0, sizeof(nnInt_t) * transform->inputCount);
-	transform->SetOutputsToBias(Outputs);
-
-	// Set the inputs based on the board
-	for (eColor c : {BLACK, WHITE} )
+	int count = 0;
+	for (ePieceType piece : { BPIECE, WPIECE, BKING, WKING })
 	{
-		uint32_t checkers = board.Bitboards.P[c] & ~board.Bitboards.K;
-		uint32_t kings = board.Bitboards.P[c] & board.Bitboards.K;
-		uint32_t piece = (c == WHITE) ? WPIECE : BPIECE;
-		while (checkers)
+		uint32_t pieces = PieceBits(board.Bitboards, piece);
+		while (pieces)
 		{
-			int sq = PopLowSq(checkers);
-			transform->AddInput( InputMap[piece][sq], Inputs, Outputs );
-		}
-		while (kings)
-		{
-			int sq = PopLowSq(kings);
-			transform->AddInput( InputMap[ piece|KING ][sq], Inputs, Outputs);
+			activeInputs[count++] = InputMap[piece][PopLowSq(pieces)];
 		}
 	}
 	if (board.sideToMove == BLACK) {
-		transform->AddInput(whiteInputCount + blackInputCount, Inputs, Outputs);
+		activeInputs[count++] = whiteInputCount + blackInputCount;
 	}
+	assert(count <= kMaxActiveInputs);
+	return count;
 }
 
 void CheckersNet::BuildInputMap()
@@ -157,37 +429,101 @@ int CheckersNet::GetInput(ePieceType piece, int sq) const
 	return (c == BLACK) ? start + sq : start + sq - 4;
 }
 
-// Incrementally update the first-layer non-activated values of the net
-void CheckersNet::IncrementalUpdate(const Move& move, const Board& board, nnInt_t firstLayerValues[])
+// Applies the changed inputs of a position to its first layer values, from fromValues (can be the same as firstLayerValues)
+void CheckersNet::ApplyInputChanges(const InputChanges& changes, const nnInt_t fromValues[], nnInt_t firstLayerValues[]) const
 {
 	const NetworkTransform<nnInt_t>* transform = network.GetTransform(0);
+	if (bFusedInputUpdates)
+	{
+		transform->UpdateInputs(fromValues, firstLayerValues, changes.added, changes.addCount, changes.removed, changes.removeCount);
+		return;
+	}
+
+	if (fromValues != firstLayerValues) memcpy(firstLayerValues, fromValues, sizeof(nnInt_t) * transform->outputCount);
+	for (int i = 0; i < changes.removeCount; i++) { transform->RemoveInput(changes.removed[i], firstLayerValues); }
+	for (int i = 0; i < changes.addCount; i++) { transform->AddInput(changes.added[i], firstLayerValues); }
+}
+
+// The inputs a move on board removes and adds
+void CheckersNet::GetMoveInputChanges(const Move& move, const Board& board, InputChanges& changes) const
+{
 	int src = move.Src();
 	int dst = move.Dst();
 	const int jumpLen = move.JumpLen();
 	ePieceType movedPiece = board.GetPiece(src);
+	changes.addCount = changes.removeCount = 0;
 
 	// remove the moved piece
-	transform->RemoveInput(InputMap[movedPiece][src], firstLayerValues);
+	changes.removed[changes.removeCount++] = InputMap[movedPiece][src];
 
 	// jump move removes jumped opponent pieces
 	if (jumpLen > 0)
 	{
 		int jumpedSq = board.GetJumpSq(src, dst);
-		transform->RemoveInput(InputMap[board.GetPiece(jumpedSq)][jumpedSq], firstLayerValues);
+		changes.removed[changes.removeCount++] = InputMap[board.GetPiece(jumpedSq)][jumpedSq];
 		for (int i = 0; i < jumpLen - 1; i++)
 		{
 			src = dst;
 			dst += JumpAddDir[move.Dir(i)];
 			jumpedSq = board.GetJumpSq(src, dst);
-			transform->RemoveInput(InputMap[board.GetPiece(jumpedSq)][jumpedSq], firstLayerValues);
+			changes.removed[changes.removeCount++] = InputMap[board.GetPiece(jumpedSq)][jumpedSq];
 		}
 	}
 
 	// add the movedPiece in the destination
 	if ( movedPiece < KING && (dst <= 3 || dst >= 28) ) movedPiece = ePieceType( movedPiece | KING );
-	transform->AddInput(InputMap[movedPiece][dst], firstLayerValues);
+	changes.added[changes.addCount++] = InputMap[movedPiece][dst];
 
 	// toggle stm
-	if (board.sideToMove == WHITE) transform->AddInput(whiteInputCount + blackInputCount, firstLayerValues);
-	else transform->RemoveInput(whiteInputCount + blackInputCount, firstLayerValues);
+	if (board.sideToMove == WHITE) changes.added[changes.addCount++] = whiteInputCount + blackInputCount;
+	else changes.removed[changes.removeCount++] = whiteInputCount + blackInputCount;
+}
+
+// Incrementally update the first-layer non-activated values of the net, from the values before the move (fromValues can be firstLayerValues)
+void CheckersNet::IncrementalUpdate(const Move& move, const Board& board, const nnInt_t fromValues[], nnInt_t firstLayerValues[]) const
+{
+	InputChanges changes;
+	GetMoveInputChanges(move, board, changes);
+	ApplyInputChanges(changes, fromValues, firstLayerValues);
+}
+
+uint32_t CheckersNet::PieceBits(const CheckerBitboards& bitboards, ePieceType piece)
+{
+	const uint32_t pieces = bitboards.P[(piece & 2) ? WHITE : BLACK];
+	return (piece & KING) ? (pieces & bitboards.K) : (pieces & ~bitboards.K);
+}
+
+// Number of inputs that differ between two positions
+int CheckersNet::InputDifference(const CheckerBitboards& fromBitboards, eColor fromSideToMove, const Board& board)
+{
+	int count = (fromSideToMove != board.sideToMove) ? 1 : 0;
+	for (ePieceType piece : { BPIECE, WPIECE, BKING, WKING })
+	{
+		count += BitCount(PieceBits(fromBitboards, piece) ^ PieceBits(board.Bitboards, piece));
+	}
+	return count;
+}
+
+// Update first-layer non-activated values computed for one position to those of board, by removing and adding only the inputs that differ
+void CheckersNet::UpdateFromPosition(const CheckerBitboards& fromBitboards, eColor fromSideToMove, const Board& board, nnInt_t firstLayerValues[]) const
+{
+	InputChanges changes;
+	changes.addCount = changes.removeCount = 0;
+	for (ePieceType piece : { BPIECE, WPIECE, BKING, WKING })
+	{
+		const uint32_t fromBits = PieceBits(fromBitboards, piece);
+		const uint32_t toBits = PieceBits(board.Bitboards, piece);
+		uint32_t removed = fromBits & ~toBits;
+		uint32_t added = toBits & ~fromBits;
+		while (removed) { changes.removed[changes.removeCount++] = InputMap[piece][PopLowSq(removed)]; }
+		while (added) { changes.added[changes.addCount++] = InputMap[piece][PopLowSq(added)]; }
+	}
+
+	// the stm input is set when black is to move
+	if (fromSideToMove != board.sideToMove)
+	{
+		if (board.sideToMove == BLACK) changes.added[changes.addCount++] = whiteInputCount + blackInputCount;
+		else changes.removed[changes.removeCount++] = whiteInputCount + blackInputCount;
+	}
+	ApplyInputChanges(changes, firstLayerValues, firstLayerValues);
 }
@@ -4,6 +4,18 @@
 
 enum class eGamePhase { EARLY, MID, END, LATE_END };
 
+// First layer size of the game phase nets when they share one first layer (see InitializeNeuralNets)
+const int kSharedFirstLayerNeurons = 256;
+
+// Inputs that change between two positions
+struct InputChanges
+{
+	int added[kMaxActiveInputs];
+	int removed[kMaxActiveInputs];
+	int addCount;
+	int removeCount;
+};
+
 struct CheckersNet : NeuralNetBase
 {
 	CheckersNet(const char* name, int inFirstLayerNeurons, eGamePhase inGamePhase)
@@ -16,15 +28,23 @@ struct CheckersNet : NeuralNetBase
 
 	void InitNetwork() override;
 	bool IsActive(const struct Board& board) const override;
-	void ConvertToInputValues(const struct Board& board, nnInt_t InputValues[]) const override;
+	int GetActiveInputs(const struct Board& board, int activeInputs[kMaxActiveInputs]) const override;
 
-	void IncrementalUpdate(const Move& move, const Board& board, nnInt_t firstLayerValues[]);
+	void IncrementalUpdate(const Move& move, const Board& board, const nnInt_t fromValues[], nnInt_t firstLayerValues[]) const;
+	void UpdateFromPosition(const CheckerBitboards& fromBitboards, eColor fromSideToMove, const Board& board, nnInt_t firstLayerValues[]) const;
+	void GetMoveInputChanges(const Move& move, const Board& board, InputChanges& changes) const;
+	void ApplyInputChanges(const InputChanges& changes, const nnInt_t fromValues[], nnInt_t firstLayerValues[]) const;
+	static int InputDifference(const CheckerBitboards& fromBitboards, eColor fromSideToMove, const Board& board);
 
 	static eGamePhase GetGamePhase(const Board& board);
 
+	// Index of the eval net whose first layer this net uses. First layer values can be updated across nets with the same index.
+	int firstLayerIdx = 0;
+
 private:
 	void BuildInputMap();
 	inline int GetInput(ePieceType piece, int sq) const;
+	static inline uint32_t PieceBits(const CheckerBitboards& bitboards, ePieceType piece);
 
 	eGamePhase gamePhase;
 	int firstLayerNeurons;
@@ -32,5 +52,12 @@ private:
 };
 
 int InitializeNeuralNets();
+bool UsingSharedFirstLayer();
 int LoadBinaryNets(const char* filename);
-void SaveBinaryNets(const char* filename);
\ No newline at end of file
+bool SaveBinaryNets(const char* filename, uint64_t* fileBytes = nullptr);
+std::string ConvertBinaryNets(const char* inFilename, const char* outFilename);
+void SetInt8HiddenLayers(bool bUse);
+void SetFixedNetworks(bool bUse);
+void SetSparseFirstLayer(bool bSparse);
+void SetFusedInputUpdates(bool bFused);
+void EvaluateBatch(const struct Board* boards, int n, int* out);
\ No newline at end of file
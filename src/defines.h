@@ -3,15 +3,15 @@
 #include <cstdint>
 #include <string>
 
-#define USE_AVX2 // Need to compile without AVX for older CPUs
+// #define USE_AVX2 // Only for the unused SIMD routines now, the neural net kernels pick SSE2/AVX2/AVX-512 at runtime (see mathSimd.cpp)
 #define USE_SSE2 // I think all 64-bit PCs have SSE2, so no reason to turn this off
 // #define NO_POP_COUNT // for very old processors that have no hardware popcount instruction
+#define LOCKLESS_TT // xor-validate transposition table entries so multiple search threads can share the table
+#define TT_PREFETCH // prefetch the child's transposition table bucket as soon as DoMove knows its hashKey
+// #define TT_PROBE_TIMING // count cpu cycles spent in transposition table probes, shown by the TT hit rate test
+// #define EVAL_TIMING // count cpu cycles spent in neural net evals, shown by the eval cache test
 
-#ifdef USE_AVX2
-static const char* g_VersionName = "GuiNN Checkers 2.06 avx2";
-#else
 static const char* g_VersionName = "GuiNN Checkers 2.06";
-#endif
 
 const int MAX_GAMEMOVES = 2048;
 const int INV = 33; // invalid square
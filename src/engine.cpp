@@ -142,10 +142,12 @@ void RunningDisplay(SearchInfo& displayInfo, const Move& bestMove, bool bSearchi
 		j += sprintf(sTemp + j, "%s\n", bSearching ? "(searching...)" : "");
 	}
 
+	// Nodes and speed are the totals from all search threads
+	const uint64_t nodes = engine.SearchNodes();
 	float seconds = TimeSince( displayInfo.startTimeMs );
 	int nps = 0;
 	if (seconds > 0.0f)
-		nps = int(float(displayInfo.nodes) / (1000.0 * seconds));
+		nps = int(float(nodes) / (1000.0 * seconds));
 
 	if (abs(displayInfo.eval) < 3000)
 		LastEval = displayInfo.eval;
@@ -182,21 +184,40 @@ void RunningDisplay(SearchInfo& displayInfo, const Move& bestMove, bool bSearchi
 		Transcript::GetMoveString(LastBest).c_str(),
 		seconds,
 		nps,
-		GetNodeCount(displayInfo.nodes, 0),
+		GetNodeCount(nodes, 0),
 		GetNodeCount(displayInfo.databaseNodes, 1) );
 
 	if (!checkerBoard.bActive)
 		j += sprintf(sTemp + j, "\n");
 
-	j += sprintf(sTemp + j, "%s", displayInfo.pv.ToString().c_str());
+	// MultiPV analysis lists every ranked root move, CheckerBoard only has room for the moves and evals
+	const SearchThreadData& mainSearch = engine.searchThreadData;
+	if (mainSearch.multiPVCount > 1)
+	{
+		const int maxChars = checkerBoard.bActive ? 1024 - 64 : (int)sizeof(sTemp) - 256; // CheckerBoard's info string is 1024 chars
+		for (int i = 0; i < mainSearch.multiPVCount && j < maxChars; i++)
+		{
+			const MultiPVLine& line = mainSearch.multiPVLines[i];
+			if (checkerBoard.bActive) {
+				j += sprintf(sTemp + j, "%d. %s (%d)  ", i + 1, Transcript::GetMoveString(line.pv.moves[0]).c_str(), -line.eval);
+			} else {
+				j += sprintf(sTemp + j, "\n%d.  Eval: %d  Depth: %d   %s", i + 1, -line.eval, line.depth, line.pv.ToString(12).c_str());
+			}
+		}
+	}
+	else {
+		j += sprintf(sTemp + j, "%s", displayInfo.pv.ToString().c_str());
+	}
 
 	DisplayText(sTemp);
 }
 
 void Engine::NewGame( const Board& startBoard, bool resetTranscript )
 {
+	StopPondering();
 	board = startBoard;
 	searchThreadData.historyTable.Clear();
+	for (auto helper : helperThreadData) { helper->historyTable.Clear(); }
 
 	if (resetTranscript) { 
 		transcript.Init(startBoard); 
@@ -228,10 +249,93 @@ std::string Engine::GetInfoString()
 	int numLoadedNets = 0;
 	for (auto net : evalNets) { numLoadedNets += (net->isLoaded) ? 1 : 0; }
 	displayStr += "Neural Nets : " + std::to_string(numLoadedNets) + "\n";
+	displayStr += "SIMD Kernels : " + std::string(SIMD::LevelName(SIMD::KernelLevel())) + (bUseInt8HiddenLayers ? ", int8 hidden layer" : "") + "\n";
+
+	displayStr += "Search Threads : " + std::to_string(numThreads) + "\n";
+	displayStr += "Hash Table : " + std::to_string(TTable.TableSizeMb()) + " MB, " + TTable.PageSizeString() + "\n";
+	if (TTable.IsFileMapped()) {
+		displayStr += "Hash File : " + TTable.filePath + "\n";
+	}
 
 	return displayStr;
 }
 
+// Set the number of search threads. Threads past the first are lazy SMP helpers with their own stack and history.
+// returns true if successful, the helper data can't be changed while a search is using it
+bool Engine::SetThreadCount(int count)
+{
+	if (IsSearching()) return false;
+	count = ClampInt(count, 1, MAX_SEARCH_THREADS);
+
+	while ((int)helperThreadData.size() > count - 1)
+	{
+		delete helperThreadData.back();
+		helperThreadData.pop_back();
+	}
+	while ((int)helperThreadData.size() < count - 1)
+	{
+		SearchThreadData* helper = new SearchThreadData;
+		helper->threadIdx = (int)helperThreadData.size() + 1;
+		helper->historyTable.Clear();
+		helper->Alloc(firstLayerOutputCount);
+		helperThreadData.push_back(helper);
+	}
+
+	numThreads = count;
+	return true;
+}
+
+// Total nodes searched by all threads in the current (or last) search
+uint64_t Engine::SearchNodes() const
+{
+	uint64_t nodes = searchThreadData.displayInfo.nodes;
+	for (auto helper : helperThreadData) { nodes += helper->displayInfo.nodes; }
+	return nodes;
+}
+
+// Map the transposition table to a file, continuing from the table already in it if there is one.
+// Returns a status message.
+std::string Engine::OpenHashFile(const std::string& path)
+{
+	if (IsSearching()) return "Can't open a hash file during a search";
+
+	bool bReloaded = false;
+	std::string error;
+	if (!TTable.MapFile(path, TTable.sizeMb, bReloaded, error))
+	{
+		if (!TTable.SetSizeMB(TTable.sizeMb))
+			TTable.SetSizeMB(64);
+		return "Could not open hash file " + path + " : " + error;
+	}
+
+	// Continue the aging from the saved table, so its entries aren't all treated as old
+	if (bReloaded) { ttAge = TTable.fileHeader->ttAge; }
+	TTable.SetFileAge(ttAge);
+
+	return std::string(bReloaded ? "Reloaded " : "Created ") + std::to_string(TTable.TableSizeMb()) + " MB hash file " + path;
+}
+
+void Engine::SaveHashFile()
+{
+	if (TTable.IsFileMapped())
+	{
+		TTable.SetFileAge(ttAge);
+		TTable.FlushFile();
+	}
+}
+
+// Save and unmap the hash file, going back to a table in memory. Returns a status message.
+std::string Engine::CloseHashFile()
+{
+	if (!TTable.IsFileMapped()) return "No hash file open";
+	if (IsSearching()) return "Can't close the hash file during a search";
+
+	SaveHashFile();
+	if (!TTable.SetSizeMB(TTable.sizeMb))
+		TTable.SetSizeMB(64);
+	return "Closed hash file";
+}
+
 // TODO : convert to std::thread
 HANDLE hEngineReady, hAction;
 HANDLE hThread;
@@ -249,9 +353,19 @@ DWORD WINAPI ThinkingThread(void* /* param */)
 
 		GUI.SetComputerColor((eColor)engine.board.sideToMove);
 		BestMoveInfo moveInfo = ComputerMove( engine.board, engine.searchThreadData);
-		GUI.DoGameMove(moveInfo.move);
-		GUI.ThinkingMenuActive(false);
-		engine.bThinking = false;
+		while (true)
+		{
+			GUI.DoGameMove(moveInfo.move);
+			const bool bPondering = engine.StartPondering(moveInfo.move);
+			GUI.ThinkingMenuActive(false);
+			engine.bThinking = false;
+			if (!bPondering) break;
+
+			// Search the expected reply while the opponent thinks. On a ponder hit StartThinking turns this into the real search.
+			moveInfo = ComputerMove(engine.ponderBoard, engine.searchThreadData);
+			while (engine.bPondering) { Sleep(1); } // the search can end early (book move, forced line), wait for the opponent
+			if (!engine.bThinking) break; // ponder miss
+		}
 	}
 
 	CloseHandle(hThread);
@@ -271,7 +385,7 @@ void Engine::Init(char* status_str)
 
 	searchThreadData.historyTable.Clear();
 
-	int firstLayerOutputCount = 0;
+	firstLayerOutputCount = 0;
 	for (auto net : evalNets)
 		firstLayerOutputCount = std::max(firstLayerOutputCount, net->network.GetLayer(0)->outputCount);
 
@@ -286,8 +400,11 @@ void Engine::Init(char* status_str)
 		get_book_setting(&checkerBoard.useOpeningBook);
 		get_dbmbytes(&checkerBoard.wld_cache_mb);
 		get_max_dbpieces(&checkerBoard.max_dbpieces);
+		get_threads(&numThreads);
 	}
 
+	SetThreadCount(numThreads);
+
 	if (!TTable.SetSizeMB(TTable.sizeMb))
 		TTable.SetSizeMB(64);
 
@@ -328,6 +445,7 @@ void Engine::Init(char* status_str)
 
 void Engine::MoveNow()
 {
+	StopPondering();
 	if (bThinking) {
 		bStopThinking = true;
 		WaitForSingleObject(hEngineReady, 500);
@@ -336,9 +454,50 @@ void Engine::MoveNow()
 
 void Engine::StartThinking()
 {
+	if (bPondering && board.CalcHashKey() == ponderBoard.CalcHashKey())
+	{
+		// Ponder hit : the running search is already on this board, it continues as the real search and keeps its elapsed time
+		bThinking = true;
+		searchLimits.newIterationMaxTime = searchLimits.maxSeconds * .60;
+		bPondering = false;
+		return;
+	}
+
+	// Ponder miss : stop that search, the new one starts with the TT it warmed up
+	StopPondering();
+
 	WaitForSingleObject(hEngineReady, 1000);
 	engine.bStopThinking = false;
 	engine.bThinking = true;
 	engine.searchLimits.newIterationMaxTime = engine.searchLimits.maxSeconds * .60;
 	SetEvent(hAction);
+}
+
+// After playing a move, ponder on the reply expected from the PV of the search that chose it.
+// Called from the thinking thread, returns true if that thread should search ponderBoard.
+bool Engine::StartPondering(Move playedMove)
+{
+	const SPrincipalVariation& pv = searchThreadData.displayInfo.pv;
+	if (!bPonder || computerColor == NO_COLOR || pv.count < 2 || pv.moves[0] != playedMove)
+		return false;
+
+	MoveList replies;
+	replies.FindMoves(board);
+	if (replies.FindIndex(pv.moves[1]) < 0)
+		return false;
+
+	ponderBoard = board;
+	ponderBoard.DoMove(pv.moves[1]);
+	bStopThinking = false;
+	bPondering = true;
+	return true;
+}
+
+void Engine::StopPondering()
+{
+	if (bPondering) {
+		bPondering = false;
+		bStopThinking = true;
+		WaitForSingleObject(hEngineReady, 500);
+	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 
 #include "board.h"
 #include "cb_interface.h"
@@ -20,13 +21,29 @@ struct Engine
 	void NewGame(const Board& startBoard, bool resetTranscript);
 	void MoveNow();
 	void StartThinking();
+	bool StartPondering(Move playedMove);
+	void StopPondering();
 	std::string GetInfoString();
+	bool SetThreadCount(int count);
+	uint64_t SearchNodes() const;
+	bool IsSearching() const { return bThinking || bPondering; }
+	std::string OpenHashFile(const std::string& path);
+	void SaveHashFile();
+	std::string CloseHashFile();
 
 	// DATA
 	eColor	computerColor = WHITE;
-	bool	bThinking = false;
-	bool	bStopThinking = false;
+	// Shared between the gui, main search and helper threads
+	std::atomic<bool> bThinking{ false };
+	std::atomic<bool> bStopThinking{ false };
+	std::atomic<bool> bStopHelpers{ false };
+	std::atomic<bool> bPonder{ false }; // search the opponent's expected reply while they think
+	std::atomic<bool> bPondering{ false };
 	bool    bUseHashTable = true;
+	bool    bUseNetRefreshCache = true;
+	bool    bUseEvalCache = true;
+	bool    bUseStagedMoveGen = false; // no measured speed gain yet, compare with RunStagedMoveGenBench
+	bool    bUseInt8HiddenLayers = false;
 	uint8_t ttAge = 0;
 
 	TranspositionTable TTable;
@@ -36,15 +53,22 @@ struct Engine
 	SDatabaseInfo dbInfo;
 	std::vector<CheckersNet*> evalNets;
 	std::string binaryNetFile = "Nets206.gnn";
+	std::string sharedBinaryNetFile = "NetsShared.gnn"; // nets with a shared first layer, used instead when present
 
 	Board board; // current game board
+	Board ponderBoard; // board after the expected reply, searched while pondering
 	Transcript transcript;
 	uint64_t boardHashHistory[MAX_GAMEMOVES];
 
-	// If we add multi-threaded search, this would be per-thread
+	// Main search thread, plus any lazy SMP helper threads
 	SearchThreadData searchThreadData;
+	std::vector<SearchThreadData*> helperThreadData;
+	int numThreads = 1;
+	int firstLayerOutputCount = 0;
 };
 
+const int MAX_SEARCH_THREADS = 64;
+
 // we have one global engine
 extern Engine engine;
 
@@ -8,7 +8,8 @@
 #include "kr_db.h"
 
 // return eval relative to board.sideToMove
-int Board::EvaluateBoard(int ply, SearchThreadData& search, const EvalNetInfo& netInfo, int depth) const
+// The board is search.stack[ply].board, the neural net values for it are in search.stack[ply].netInfo
+int Board::EvaluateBoard(int ply, SearchThreadData& search, int depth) const
 {
 	// Game is over?        
 	if ((numPieces[WHITE] == 0 && sideToMove == WHITE) || (numPieces[BLACK] == 0 && sideToMove == BLACK)) {
@@ -68,24 +69,49 @@ int Board::EvaluateBoard(int ply, SearchThreadData& search, const EvalNetInfo& n
 	{
 		eval = AllKingsEval();
 	}
+	else if (engine.bUseEvalCache && search.evalCache.Probe(hashKey, eval))
+	{
+		// Net eval of a position evaluated recently
+		search.displayInfo.evalCacheProbes++;
+		search.displayInfo.evalCacheHits++;
+	}
 	else
 	{
 		// NEURAL NET EVAL
+#ifdef EVAL_TIMING
+		const uint64_t evalStartCycles = __rdtsc();
+#endif
+		const EvalNetInfo& netInfo = UpdateFirstLayerValues(search, ply);
 		assert(netInfo.firstLayerValues && netInfo.netIdx >= 0);
-		eval = engine.evalNets[netInfo.netIdx]->GetSumIncremental(netInfo.firstLayerValues, search.nnValues);
-		eval = -SoftClamp(eval / 3, 400, 800); // move it into a better range with rest of evaluation
-
-		// surely winning material advantage?
-		if (numPieces[WHITE] >= numPieces[BLACK] + 2)
-			eval += (numPieces[BLACK] == 1) ? 150 : 50;
-		if (numPieces[BLACK] >= numPieces[WHITE] + 2)
-			eval -= (numPieces[WHITE] == 1) ? 150 : 50;
+		eval = NetEval(engine.evalNets[netInfo.netIdx]->GetSumIncremental(netInfo.firstLayerValues));
+#ifdef EVAL_TIMING
+		search.displayInfo.netEvalCycles += __rdtsc() - evalStartCycles;
+#endif
+		if (engine.bUseEvalCache)
+		{
+			search.displayInfo.evalCacheProbes++;
+			search.evalCache.Store(hashKey, eval);
+		}
 	}
 
 	// return sideToMove relative eval
 	return(to_rel_score(eval, sideToMove));
 }
 
+// The white relative eval for the sum of the neural net
+int Board::NetEval(int netSum) const
+{
+	int eval = -SoftClamp(netSum / 3, 400, 800); // move it into a better range with rest of evaluation
+
+	// surely winning material advantage?
+	if (numPieces[WHITE] >= numPieces[BLACK] + 2)
+		eval += (numPieces[BLACK] == 1) ? 150 : 50;
+	if (numPieces[BLACK] >= numPieces[WHITE] + 2)
+		eval -= (numPieces[WHITE] == 1) ? 150 : 50;
+
+	return eval;
+}
+
 // For positions with all kings to help finish the game. 
 // (TODO? Could train a small net to handle this using some distance to win metric in targetVal.)
 // (TODO? generalize to use for any lop-sided position that should be easy win.)
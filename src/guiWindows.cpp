@@ -137,6 +137,7 @@ void WindowsGUI::UpdateMenuChecks()
 	CheckMenuItem(menu, ID_OPTIONS_EXPERT, (engine.searchLimits.maxDepth == EXPERT_DEPTH) ? MF_CHECKED : MF_UNCHECKED);
 
 	CheckMenuItem(menu, ID_GAME_HASHING, (engine.bUseHashTable) ? MF_CHECKED : MF_UNCHECKED);
+	CheckMenuItem(menu, ID_GAME_PONDERING, (engine.bPonder) ? MF_CHECKED : MF_UNCHECKED);
 
 	CheckMenuItem(menu, ID_OPTIONS_COMPUTERWHITE, (engine.computerColor == WHITE) ? MF_CHECKED : MF_UNCHECKED);
 	CheckMenuItem(menu, ID_OPTIONS_COMPUTERBLACK, (engine.computerColor == BLACK) ? MF_CHECKED : MF_UNCHECKED);
@@ -441,6 +442,7 @@ int WindowsGUI::GetSquare(int x, int y)
 
 void WindowsGUI::SetComputerColor(eColor Color)
 {
+	if (Color != engine.computerColor) engine.StopPondering();
 	engine.computerColor = Color;
 	UpdateMenuChecks();
 }
@@ -528,9 +530,9 @@ void WindowsGUI::KeyboardCommands(int key)
 	if (key == 'T')
 	{
 		// show TT entry
-		TEntry* entry = engine.TTable.GetEntry(engine.board, engine.ttAge);
-		if (entry && entry->IsBoard(engine.board.hashKey)) {
-			DisplayText(GetTTEntryString(entry, engine.board.sideToMove).c_str());
+		TEntry entry = engine.TTable.GetEntry(engine.board, engine.ttAge)->Load();
+		if (entry.IsBoard(engine.board.hashKey)) {
+			DisplayText(GetTTEntryString(&entry, engine.board.sideToMove).c_str());
 		} else {
 			DisplayText("No TT Entry for board");
 		}
@@ -658,6 +660,12 @@ void WindowsGUI::ProcessMenuCommand(WORD cmd, HWND hwnd)
 		engine.TTable.Clear();
 		break;
 
+	case ID_GAME_PONDERING:
+		engine.bPonder = !engine.bPonder;
+		if (!engine.bPonder) engine.StopPondering();
+		GUI.UpdateMenuChecks();
+		break;
+
 	case ID_OPTIONS_BEGINNER: SetSearchDepth(BEGINNER_DEPTH); break;
 	case ID_OPTIONS_NORMAL:   SetSearchDepth(NORMAL_DEPTH); break;
 	case ID_OPTIONS_EXPERT:   SetSearchDepth(EXPERT_DEPTH); break;
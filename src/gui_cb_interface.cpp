@@ -8,6 +8,8 @@
 #include "checkersGui.h"
 #include "kr_db.h"
 #include "registry.h"
+#include "bench.h"
+#include "perft.h"
 
 int ConvertFromCB[16] = { 0, 0, 0, 0, 0, 2, 1, 0, 0, 6, 5, 0, 0, 0, 0, 0 };
 int ConvertToCB[16] = { 0, 6, 5, 0, 0, 10, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
@@ -164,7 +166,9 @@ int WINAPI getmove
 	SetSearchTimeLimits( maxtime, info, moreinfo);
 
 	engine.computerColor = engine.board.sideToMove;
+	engine.bThinking = true; // so engine commands don't change the table or threads under the search
 	BestMoveInfo bestMove = ComputerMove(engine.board, engine.searchThreadData);
+	engine.bThinking = false;
 
 	if (bestMove.move != NO_MOVE)
 	{
@@ -231,6 +235,207 @@ int WINAPI enginecommand(char str[256], char reply[1024])
 		return(1);
 	}
 
+	if (strcmp(command, "smptest") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int numThreads = (param1[0]) ? strtol(param1, &stopstring, 10) : engine.numThreads;
+		int depth = (param2[0]) ? strtol(param2, &stopstring, 10) : 19;
+		snprintf(reply, REPLY_MAX, "%s", RunSmpSpeedupTest(std::max(numThreads, 2), ClampInt(depth, 2, MAX_SEARCHDEPTH - 10)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "ttsize") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int sizeMb = (param1[0]) ? strtol(param1, &stopstring, 10) : engine.TTable.sizeMb;
+		int depth = (param2[0]) ? strtol(param2, &stopstring, 10) : 21;
+		snprintf(reply, REPLY_MAX, "%s", RunTTSizeTest(std::max(sizeMb, 1), ClampInt(depth, 2, MAX_SEARCHDEPTH - 10)).c_str());
+		return(1);
+	}
+
+	// hashfile open <path> | save | close
+	if (strcmp(command, "hashfile") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		if (strcmp(param1, "open") == 0 && param2[0]) {
+			snprintf(reply, REPLY_MAX, "%s", engine.OpenHashFile(param2).c_str());
+			return(1);
+		}
+		if (strcmp(param1, "save") == 0) {
+			engine.SaveHashFile();
+			if (engine.TTable.IsFileMapped())
+				snprintf(reply, REPLY_MAX, "saved hash file %s", engine.TTable.filePath.c_str());
+			else
+				strcpy(reply, "no hash file open");
+			return(1);
+		}
+		if (strcmp(param1, "close") == 0) {
+			snprintf(reply, REPLY_MAX, "%s", engine.CloseHashFile().c_str());
+			return(1);
+		}
+		return(0);
+	}
+
+	if (strcmp(command, "ttstress") == 0) {
+		int numThreads = (param1[0]) ? strtol(param1, &stopstring, 10) : std::max(2, (int)std::thread::hardware_concurrency());
+		int seconds = (param2[0]) ? strtol(param2, &stopstring, 10) : 10;
+		snprintf(reply, REPLY_MAX, "%s", RunTTStressTest(ClampInt(numThreads, 1, MAX_SEARCH_THREADS), ClampInt(seconds, 1, 600)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "netrefresh") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int depth = (param1[0]) ? strtol(param1, &stopstring, 10) : 19;
+		snprintf(reply, REPLY_MAX, "%s", RunNetRefreshTest(ClampInt(depth, 2, MAX_SEARCHDEPTH - 10)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "evalcache") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int depth = (param1[0]) ? strtol(param1, &stopstring, 10) : 19;
+		snprintf(reply, REPLY_MAX, "%s", RunEvalCacheTest(ClampInt(depth, 2, MAX_SEARCHDEPTH - 10)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "bench") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int depth = (param1[0]) ? strtol(param1, &stopstring, 10) : 17;
+		uint64_t maxNodes = (param2[0]) ? strtoull(param2, &stopstring, 10) : 0;
+		snprintf(reply, REPLY_MAX, "%s", RunBench(ClampInt(depth, 2, MAX_SEARCHDEPTH - 10), maxNodes).c_str());
+		return(1);
+	}
+
+	// perft <depth> [position] : perft of the start position or a FEN position, split across the engine threads
+	if (strcmp(command, "perft") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int depth = (param1[0]) ? strtol(param1, &stopstring, 10) : 10;
+		Board board = Board::StartPosition();
+		if (param2[0] && !board.FromString(param2)) {
+			snprintf(reply, REPLY_MAX, "Could not read position %s", param2);
+			return(1);
+		}
+		snprintf(reply, REPLY_MAX, "%s", RunPerft(board, ClampInt(depth, 0, 20), engine.numThreads, 64).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "perfttest") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int depth = (param1[0]) ? strtol(param1, &stopstring, 10) : 11;
+		snprintf(reply, REPLY_MAX, "%s", RunPerftTest(ClampInt(depth, 1, 14), engine.numThreads).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "multipvbench") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int depth = (param1[0]) ? strtol(param1, &stopstring, 10) : 17;
+		int lineCount = (param2[0]) ? strtol(param2, &stopstring, 10) : 4;
+		snprintf(reply, REPLY_MAX, "%s", RunMultiPVBench(ClampInt(depth, 2, MAX_SEARCHDEPTH - 10), ClampInt(lineCount, 1, MoveList::MAX_MOVES)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "movegenbench") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int depth = (param1[0]) ? strtol(param1, &stopstring, 10) : 17;
+		snprintf(reply, REPLY_MAX, "%s", RunStagedMoveGenBench(ClampInt(depth, 2, MAX_SEARCHDEPTH - 10)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "evalbench") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int iterations = (param1[0]) ? strtol(param1, &stopstring, 10) : 20000;
+		snprintf(reply, REPLY_MAX, "%s", RunEvalKernelBench(ClampInt(iterations, 1, 10000000)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "int8test") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int numPositions = (param1[0]) ? strtol(param1, &stopstring, 10) : 100000;
+		snprintf(reply, REPLY_MAX, "%s", RunInt8AccuracyTest(ClampInt(numPositions, 1, 1000000)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "sparsebench") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int depth = (param1[0]) ? strtol(param1, &stopstring, 10) : 19;
+		snprintf(reply, REPLY_MAX, "%s", RunSparseLayerBench(ClampInt(depth, 2, MAX_SEARCHDEPTH - 10)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "batchbench") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int numPositions = (param1[0]) ? strtol(param1, &stopstring, 10) : 100000;
+		int numThreads = (param2[0]) ? strtol(param2, &stopstring, 10) : std::max(1, (int)std::thread::hardware_concurrency());
+		snprintf(reply, REPLY_MAX, "%s", RunEvalBatchBench(ClampInt(numPositions, 1, 1000000), ClampInt(numThreads, 1, MAX_SEARCH_THREADS)).c_str());
+		return(1);
+	}
+
+	if (strcmp(command, "updatebench") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		int numPositions = (param1[0]) ? strtol(param1, &stopstring, 10) : 100000;
+		snprintf(reply, REPLY_MAX, "%s", RunInputUpdateBench(ClampInt(numPositions, 1, 1000000)).c_str());
+		return(1);
+	}
+
+	// convertnets <in> <out> : rewrite a binary net file in the mapped format
+	if (strcmp(command, "convertnets") == 0) {
+		if (!checkerBoard.bActive) {
+			strcpy(reply, "Engine not initialized yet. Do a search first.\n");
+			return(1);
+		}
+		if (!param1[0] || !param2[0]) {
+			strcpy(reply, "usage : convertnets <in> <out>\n");
+			return(1);
+		}
+		if (engine.IsSearching()) {
+			strcpy(reply, "can't convert nets during a search");
+			return(1);
+		}
+		snprintf(reply, REPLY_MAX, "%s", ConvertBinaryNets(param1, param2).c_str());
+		return(1);
+	}
+
 	if (strcmp(param1, "check_wld_dir") == 0) {
 		check_wld_dir(param2, reply);
 		return(1);
@@ -245,6 +450,10 @@ int WINAPI enginecommand(char str[256], char reply[1024])
 			if (numMBs < 1)
 				return 0;
 			numMBs = ClampInt(numMBs, 1, 4096);
+			if (engine.IsSearching()) {
+				strcpy(reply, "can't change the hash size during a search");
+				return 1;
+			}
 			while (!engine.TTable.SetSizeMB(numMBs)) {
 				numMBs /= 2;
 				snprintf(reply, REPLY_MAX, "allocation failed, downsizing to %dmb", numMBs);
@@ -317,6 +526,44 @@ int WINAPI enginecommand(char str[256], char reply[1024])
 			sprintf(reply, "dbmbytes set to %d", checkerBoard.wld_cache_mb);
 			return(1);
 		}
+
+		if (strcmp(param1, "threads") == 0) {
+			val = strtol(param2, &stopstring, 10);
+			if (val < 1)
+				return 0;
+			if (!engine.SetThreadCount(val)) {
+				strcpy(reply, "can't change the threads during a search");
+				return 1;
+			}
+			save_threads(engine.numThreads);
+
+			snprintf(reply, REPLY_MAX, "threads set to %d", engine.numThreads);
+			return(1);
+		}
+
+		if (strcmp(param1, "int8") == 0) {
+			val = strtol(param2, &stopstring, 10);
+			if (engine.IsSearching()) {
+				strcpy(reply, "can't change int8 during a search");
+				return 1;
+			}
+			SetInt8HiddenLayers(val != 0);
+			snprintf(reply, REPLY_MAX, "int8 set to %d", engine.bUseInt8HiddenLayers ? 1 : 0);
+			return(1);
+		}
+
+		if (strcmp(param1, "multipv") == 0) {
+			val = strtol(param2, &stopstring, 10);
+			engine.searchLimits.multiPV = ClampInt(val, 1, MoveList::MAX_MOVES);
+			snprintf(reply, REPLY_MAX, "multipv set to %d", engine.searchLimits.multiPV);
+			return(1);
+		}
+
+		if (strcmp(param1, "maxnodes") == 0) {
+			engine.searchLimits.maxNodes = strtoull(param2, &stopstring, 10);
+			snprintf(reply, REPLY_MAX, "maxnodes set to %llu", (unsigned long long)engine.searchLimits.maxNodes);
+			return(1);
+		}
 	}
 
 	if (strcmp(command, "get") == 0) {
@@ -365,6 +612,22 @@ int WINAPI enginecommand(char str[256], char reply[1024])
 			sprintf(reply, "%d",checkerBoard.wld_cache_mb);
 			return(1);
 		}
+
+		if (strcmp(param1, "threads") == 0) {
+			get_threads(&engine.numThreads);
+			snprintf(reply, REPLY_MAX, "%d", engine.numThreads);
+			return(1);
+		}
+
+		if (strcmp(param1, "multipv") == 0) {
+			snprintf(reply, REPLY_MAX, "%d", engine.searchLimits.multiPV);
+			return(1);
+		}
+
+		if (strcmp(param1, "maxnodes") == 0) {
+			snprintf(reply, REPLY_MAX, "%llu", (unsigned long long)engine.searchLimits.maxNodes);
+			return(1);
+		}
 	}
 
 	strcpy(reply, "?");
@@ -28,16 +28,17 @@ void NeuralNetLearner::WriteNetStructure(const char* filePath, const NeuralNetwo
 	}
 }
 
-void NeuralNetLearner::WriteNetInputsBinary(FILE* fp, nnInt_t InputValues[], int32_t inputCount)
+void NeuralNetLearner::WriteNetInputsBinary(FILE* fp, const int activeInputs[], int activeCount, int32_t inputCount)
 {
 	const int kMaxBufferSize = 4096;
 	assert(inputCount < kMaxBufferSize);
 
 	// Build inputs into 1-byte per input buffer. They are just 0 or 1 right now, but would have to do conversion if that changes.
 	uint8_t writeBuf[kMaxBufferSize];
-	for (int32_t i = 0; i < inputCount; i++)
+	memset(writeBuf, 0, inputCount);
+	for (int i = 0; i < activeCount; i++)
 	{
-		writeBuf[i] = (uint8_t)InputValues[i];
+		writeBuf[activeInputs[i]] = 1;
 	}
 
 	// Write the buffer to the file
@@ -99,6 +100,12 @@ void NeuralNetLearner::ConvertGamesToPositions( std::vector<std::string> pdnFile
 
 void NeuralNetLearner::ExportTrainingSet(std::vector<TrainingPosition>& positionSet )
 {
+	if (UsingSharedFirstLayer())
+	{
+		ExportSharedTrainingSet(positionSet);
+		return;
+	}
+
 	// Export training data for each net, for all positions in the set the net is active for
 	for (auto net : engine.evalNets )
 	{
@@ -107,19 +114,19 @@ void NeuralNetLearner::ExportTrainingSet(std::vector<TrainingPosition>& position
 		FILE* posFile = fopen(net->trainingPositionFile.c_str(), "wb");
 		if (posFile)
 		{
-			nnInt_t inputValues[1024];
+			int activeInputs[kMaxActiveInputs];
 			const int inputCount = net->network.InputCount();
 
 			for (auto& pos : positionSet)
 			{
 				if (net->IsActive(pos.board)) 
 				{
-					net->ConvertToInputValues(pos.board, inputValues);
-					WriteNetInputsBinary(posFile, inputValues, inputCount);
+					int activeCount = net->GetActiveInputs(pos.board, activeInputs);
+					WriteNetInputsBinary(posFile, activeInputs, activeCount, inputCount);
 
 					// Export flipped board to take advantage of symettry
-					net->ConvertToInputValues( pos.board.Flip(), inputValues);
-					WriteNetInputsBinary(posFile, inputValues, inputCount);
+					activeCount = net->GetActiveInputs(pos.board.Flip(), activeInputs);
+					WriteNetInputsBinary(posFile, activeInputs, activeCount, inputCount);
 				}
 			}
 
@@ -145,6 +152,45 @@ void NeuralNetLearner::ExportTrainingSet(std::vector<TrainingPosition>& position
 	}
 }
 
+// The nets with a shared first layer are trained together, so export every position to one set (CheckersSharedData.dat etc.)
+// with the index of the net that's active for it in CheckersSharedPhases.dat (one byte per position)
+void NeuralNetLearner::ExportSharedTrainingSet(std::vector<TrainingPosition>& positionSet)
+{
+	const std::string sharedName = neuralNetDir + "CheckersShared";
+	const CheckersNet* net = engine.evalNets[0];
+	WriteNetStructure((sharedName + "Struct.txt").c_str(), net->network);
+
+	FILE* posFile = fopen((sharedName + "Data.dat").c_str(), "wb");
+	FILE* labelFile = fopen((sharedName + "Labels.dat").c_str(), "wb");
+	FILE* phaseFile = fopen((sharedName + "Phases.dat").c_str(), "wb");
+	if (posFile && labelFile && phaseFile)
+	{
+		int activeInputs[kMaxActiveInputs];
+		const int inputCount = net->network.InputCount();
+
+		for (auto& pos : positionSet)
+		{
+			// Export flipped board too to take advantage of symettry. It has the same piece counts so the same game phase.
+			const uint8_t netIdx = (uint8_t)CheckersNet::GetGamePhase(pos.board);
+			const float flippedTargetVal = 1.0f - pos.targetVal;
+
+			int activeCount = net->GetActiveInputs(pos.board, activeInputs);
+			WriteNetInputsBinary(posFile, activeInputs, activeCount, inputCount);
+			fwrite(&pos.targetVal, sizeof(float), 1, labelFile);
+			fwrite(&netIdx, sizeof(uint8_t), 1, phaseFile);
+
+			activeCount = net->GetActiveInputs(pos.board.Flip(), activeInputs);
+			WriteNetInputsBinary(posFile, activeInputs, activeCount, inputCount);
+			fwrite(&flippedTargetVal, sizeof(float), 1, labelFile);
+			fwrite(&netIdx, sizeof(uint8_t), 1, phaseFile);
+		}
+	}
+
+	if (posFile) fclose(posFile);
+	if (labelFile) fclose(labelFile);
+	if (phaseFile) fclose(phaseFile);
+}
+
 void NeuralNetLearner::CreateTrainingSet()
 {
 	std::vector<TrainingPosition> positionSet;
@@ -33,7 +33,8 @@ public:
 
 private:
 	static void WriteNetStructure(const char* filePath, const NeuralNetwork<nnInt_t>& network);
-	static void WriteNetInputsBinary(FILE* fp, nnInt_t InputValues[], int32_t inputCount);
+	static void WriteNetInputsBinary(FILE* fp, const int activeInputs[], int activeCount, int32_t inputCount);
 	static void ConvertGamesToPositions(std::vector<std::string> pdnFilenames, std::vector<TrainingPosition>& positionSet);
 	static void ExportTrainingSet(std::vector<TrainingPosition>& positionSet);
+	static void ExportSharedTrainingSet(std::vector<TrainingPosition>& positionSet);
 };
\ No newline at end of file
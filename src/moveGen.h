@@ -95,6 +95,7 @@ public:
 	}
 
 	void FindMoves(Board& B);
+	bool FindMove(Board& B, const Move& move);
 	void FindJumps(const eColor color, CheckerBitboards& B, uint32_t Movers);
 	void FindNonJumps(const eColor color, const CheckerBitboards& B, uint32_t Movers);
 
@@ -125,6 +125,29 @@ void MoveList::FindMoves(Board& board)
 		FindNonJumps(board.sideToMove, board.Bitboards, board.Bitboards.GetMovers(board.sideToMove)); // Otherwise we fill the movelist with non-jump moves
 }
 
+// For staged move generation : if move is legal on the board the list is set to just that move and this returns true.
+// Only the moves of the piece on the move's source square are generated to check it.
+bool MoveList::FindMove(Board& board, const Move& move)
+{
+	const uint32_t jumpers = board.Bitboards.GetJumpers(board.sideToMove);
+
+	if (jumpers)
+		FindJumps(board.sideToMove, board.Bitboards, jumpers & SqBit(move.Src()));
+	else
+		FindNonJumps(board.sideToMove, board.Bitboards, board.Bitboards.GetMovers(board.sideToMove) & SqBit(move.Src()));
+
+	if (FindIndex(move) < 0) {
+		Clear();
+		return false;
+	}
+
+	// numJumps only needs to say if the moves are jumps until the full list is generated
+	moves[0] = move;
+	numMoves = 1;
+	numJumps = jumpers ? 1 : 0;
+	return true;
+}
+
 // -------------------------------------------------
 // These two functions only add non-jumps
 // -------------------------------------------------
@@ -0,0 +1,235 @@
+//
+// perft.cpp
+//
+// Perft counts the leaf positions of the full move tree to a fixed depth. It tests and times the move generator
+// (MoveList::FindMoves) and Board::DoMove on their own, without the search or the eval.
+// RunPerft - perft of one position, with the count for each root move and the speed.
+// RunPerftTest - reference counts for regression checks of the move generator.
+//
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "engine.h"
+#include "perft.h"
+
+// Subtree counts shared by the perft threads. As with LOCKLESS_TT entries the key is stored xor'd with the data,
+// so an entry torn by two threads writing at once won't validate, and is just a miss.
+struct PerftTable
+{
+	struct Entry
+	{
+		uint64_t check; // hashKey ^ data
+		uint64_t data;  // count << 8 | depth
+	};
+	std::vector<Entry> entries;
+	uint64_t mask = 0;
+
+	void Init(int sizeMb)
+	{
+		uint64_t numEntries = 1;
+		while (numEntries * 2 * sizeof(Entry) <= (uint64_t)sizeMb * 1024 * 1024) { numEntries *= 2; }
+		entries.assign(numEntries, Entry{ 0, 0 });
+		mask = numEntries - 1;
+	}
+
+	bool Probe(uint64_t hashKey, int depth, uint64_t& count) const
+	{
+		const Entry& entry = entries[hashKey & mask];
+		const uint64_t data = entry.data;
+		if ((entry.check ^ data) != hashKey || (data & 0xFF) != (uint64_t)depth) return false;
+		count = data >> 8;
+		return true;
+	}
+
+	void Store(uint64_t hashKey, int depth, uint64_t count)
+	{
+		Entry& entry = entries[hashKey & mask];
+		const uint64_t data = (count << 8) | (uint64_t)depth;
+		entry.data = data;
+		entry.check = hashKey ^ data;
+	}
+};
+
+struct PerftCounters
+{
+	uint64_t movesGenerated = 0;
+	uint64_t hashHits = 0;
+};
+
+struct PerftResult
+{
+	MoveList rootMoves;
+	uint64_t rootCounts[MoveList::MAX_MOVES] = {};
+	uint64_t leaves = 0;
+	uint64_t timeMs = 0;
+	PerftCounters counters;
+};
+
+static uint64_t PerftNode(Board& board, int depth, PerftTable* table, PerftCounters& counters)
+{
+	uint64_t count = 0;
+	if (table && depth > 1 && table->Probe(board.hashKey, depth, count)) {
+		counters.hashHits++;
+		return count;
+	}
+
+	MoveList moveList;
+	moveList.FindMoves(board);
+	counters.movesGenerated += moveList.numMoves;
+
+	// Bulk counting : the moves at the last ply are the leaves, so they don't need to be played
+	if (depth == 1) return moveList.numMoves;
+
+	for (int i = 0; i < moveList.numMoves; i++)
+	{
+		Board child = board;
+		child.DoMove(moveList.moves[i]);
+		count += PerftNode(child, depth - 1, table, counters);
+	}
+
+	if (table) { table->Store(board.hashKey, depth, count); }
+	return count;
+}
+
+// The root moves are handed out to the threads one at a time, so a thread that finishes a small subtree takes the next move
+static PerftResult PerftRoot(const Board& board, int depth, int numThreads, int hashMb)
+{
+	PerftResult result;
+	const uint64_t startTimeMs = GetCurrentTimeMs();
+
+	Board root = board;
+	root.hashKey = root.CalcHashKey();
+	result.rootMoves.FindMoves(root);
+	result.counters.movesGenerated = result.rootMoves.numMoves;
+
+	PerftTable table;
+	if (hashMb > 0) { table.Init(hashMb); }
+
+	numThreads = std::max(numThreads, 1);
+	std::vector<PerftCounters> threadCounters(numThreads);
+	std::atomic<int> nextMove(0);
+	auto searchRootMoves = [&](int threadIdx)
+	{
+		for (int i = nextMove++; i < result.rootMoves.numMoves; i = nextMove++)
+		{
+			Board child = root;
+			child.DoMove(result.rootMoves.moves[i]);
+			result.rootCounts[i] = (depth > 1) ? PerftNode(child, depth - 1, (hashMb > 0) ? &table : nullptr, threadCounters[threadIdx]) : 1;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < numThreads; t++) { threads.emplace_back(searchRootMoves, t); }
+	searchRootMoves(0);
+	for (auto& thread : threads) { thread.join(); }
+
+	for (int i = 0; i < result.rootMoves.numMoves; i++) { result.leaves += result.rootCounts[i]; }
+	for (const auto& counters : threadCounters)
+	{
+		result.counters.movesGenerated += counters.movesGenerated;
+		result.counters.hashHits += counters.hashHits;
+	}
+	if (depth == 0) { result.leaves = 1; }
+
+	result.timeMs = GetCurrentTimeMs() - startTimeMs;
+	return result;
+}
+
+uint64_t Perft(const Board& board, int depth, int numThreads, int hashMb)
+{
+	return PerftRoot(board, depth, numThreads, hashMb).leaves;
+}
+
+static double PerSecond(uint64_t count, uint64_t timeMs)
+{
+	return double(count) * 1000.0 / double(std::max(timeMs, (uint64_t)1));
+}
+
+std::string RunPerft(const Board& board, int depth, int numThreads, int hashMb)
+{
+	const PerftResult result = PerftRoot(board, depth, numThreads, hashMb);
+
+	char buffer[1024];
+	int j = snprintf(buffer, sizeof(buffer),
+		"Perft depth %d : %llu leaves   %.2fs   %d threads   %d MB hash (%llu hits)\n"
+		"Moves generated : %llu   %.2f M moves/s   %.2f M leaves/s\n",
+		depth, (unsigned long long)result.leaves, result.timeMs / 1000.0f, std::max(numThreads, 1), hashMb, (unsigned long long)result.counters.hashHits,
+		(unsigned long long)result.counters.movesGenerated, PerSecond(result.counters.movesGenerated, result.timeMs) / 1000000.0,
+		PerSecond(result.leaves, result.timeMs) / 1000000.0);
+
+	// Counts for each root move, to find where two move generators differ
+	for (int i = 0; i < result.rootMoves.numMoves && j < (int)sizeof(buffer) - 64; i++)
+	{
+		j += snprintf(buffer + j, sizeof(buffer) - j, "%s %llu%s", Transcript::GetMoveString(result.rootMoves.moves[i]).c_str(),
+			(unsigned long long)result.rootCounts[i], (i % 4 == 3) ? "\n" : "   ");
+	}
+
+	return buffer;
+}
+
+// Reference counts for the start position. Further positions with kings and multiple jumps use counts recorded from
+// this move generator, so any change to them is a regression.
+struct PerftReference
+{
+	const char* position;
+	int depth;
+	uint64_t count;
+};
+
+static const uint64_t g_StartPositionPerft[] = { 1, 7, 49, 302, 1469, 7361, 36768, 179740, 845931, 3963680, 18391564, 85242128, 388623673, 1766623630, 7978439499 };
+static const int g_MaxStartPositionDepth = sizeof(g_StartPositionPerft) / sizeof(g_StartPositionPerft[0]) - 1;
+
+static const PerftReference g_PerftReferences[] = {
+	{ "B:W10,14,19,24,23,27:B8,7,5,12,16,20,22,K26.", 11, 4263263 },
+	{ "B:WK11,28,27,26,25:B12,13,20,19,18.", 11, 4643609 },
+	{ "W:WK2,K5,18,23,26,27,31:BK10,K14,11,12,15,16.", 10, 1477386 },
+};
+
+std::string RunPerftTest(int maxDepth, int numThreads)
+{
+	std::string report = "Perft test\n";
+	char buffer[256];
+	bool bPassed = true;
+
+	const Board startBoard = Board::StartPosition();
+	maxDepth = std::min(maxDepth, g_MaxStartPositionDepth);
+	for (int depth = 1; depth <= maxDepth; depth++)
+	{
+		// The last depth is timed with each option, the others just need the count
+		const PerftResult hashed = PerftRoot(startBoard, depth, numThreads, 64);
+		bPassed &= (hashed.leaves == g_StartPositionPerft[depth]);
+		snprintf(buffer, sizeof(buffer), "Start position depth %d : %llu %s\n", depth, (unsigned long long)hashed.leaves,
+			(hashed.leaves == g_StartPositionPerft[depth]) ? "OK" : "FAILED");
+		report += buffer;
+
+		if (depth == maxDepth)
+		{
+			const PerftResult single = PerftRoot(startBoard, depth, 1, 0);
+			const PerftResult threaded = PerftRoot(startBoard, depth, numThreads, 0);
+			bPassed &= (single.leaves == g_StartPositionPerft[depth]) && (threaded.leaves == g_StartPositionPerft[depth]);
+			snprintf(buffer, sizeof(buffer),
+				"1 thread : %.2fs %.2f M moves/s   %d threads : %.2fs   %d threads hashed : %.2fs\n",
+				single.timeMs / 1000.0f, PerSecond(single.counters.movesGenerated, single.timeMs) / 1000000.0,
+				std::max(numThreads, 1), threaded.timeMs / 1000.0f, std::max(numThreads, 1), hashed.timeMs / 1000.0f);
+			report += buffer;
+		}
+	}
+
+	for (const auto& reference : g_PerftReferences)
+	{
+		Board board;
+		board.FromString((char*)reference.position);
+		const uint64_t count = Perft(board, reference.depth, numThreads, 0);
+		const uint64_t hashedCount = Perft(board, reference.depth, numThreads, 64);
+		const bool bOk = (count == reference.count) && (hashedCount == reference.count);
+		bPassed &= bOk;
+		snprintf(buffer, sizeof(buffer), "%s depth %d : %llu %s\n", reference.position, reference.depth, (unsigned long long)count, bOk ? "OK" : "FAILED");
+		report += buffer;
+	}
+
+	report += bPassed ? "All counts match\n" : "Perft counts FAILED\n";
+	return report;
+}
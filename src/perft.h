@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include "board.h"
+
+// Number of leaf positions of the full move tree from board to depth. Uses bulk counting at the last ply,
+// a shared hash table of subtree counts when hashMb > 0, and splits the root moves across numThreads threads.
+uint64_t Perft(const Board& board, int depth, int numThreads = 1, int hashMb = 0);
+
+// Perft of a position with the count for each root move and the speed. Returns the report as a string.
+std::string RunPerft(const Board& board, int depth, int numThreads, int hashMb);
+
+// Checks the move generator against reference perft counts, with and without the hash table. Returns the report as a string.
+std::string RunPerftTest(int maxDepth, int numThreads);
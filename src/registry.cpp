@@ -10,6 +10,7 @@
 #define ENABLE_WLD_NAME "enable_wld"
 #define DBMBYTES_NAME "dbmbytes"
 #define MAX_DBPIECES_NAME "max_dbpieces"
+#define THREADS_NAME "threads"
 
 
 /*
@@ -144,6 +145,12 @@ void save_max_dbpieces(int val)
 }
 
 
+void save_threads(int val)
+{
+	reg_set_int(THREADS_NAME, val);
+}
+
+
 /*
  * Get the hashtable size from the registry.
  * Return non-zero if key not found or other error.
@@ -188,3 +195,9 @@ int get_max_dbpieces(int *size)
 }
 
 
+int get_threads(int *count)
+{
+	return(reg_get_int(THREADS_NAME, count));
+}
+
+
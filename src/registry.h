@@ -8,11 +8,13 @@ void save_dbpath(char *path);
 void save_enable_wld(int enable_wld);
 void save_dbmbytes(int val);
 void save_max_dbpieces(int val);
+void save_threads(int val);
 int get_hashsize(int *size);
 int get_book_setting(int *setting);
 int get_dbpath(char *path, int maxlen);
 int get_enable_wld(int *enable_wld);
 int get_dbmbytes(int *size);
 int get_max_dbpieces(int *size);
+int get_threads(int *count);
 
 
@@ -43,13 +43,14 @@
 #define ID_DEVELOPER_IMPORTLATESTMATCHES 40035
 #define ID_DEVELOPER_SAVEBINARYNETS     40036
 #define ID_DEVELOPER_SAVE_BINARY_NETS   40037
+#define ID_GAME_PONDERING               40038
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        121
-#define _APS_NEXT_COMMAND_VALUE         40038
+#define _APS_NEXT_COMMAND_VALUE         40039
 #define _APS_NEXT_CONTROL_VALUE         1002
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
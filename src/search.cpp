@@ -3,11 +3,12 @@
 // by Jonathan Kreuzer
 //
 // Alpha-Beta search and related functionality.
-// TODO : lazy SMP support
+// Lazy SMP : helper threads search the same root position, and only share the transposition table with the main thread.
 // 
 
 #include <stdlib.h>
 #include <algorithm>
+#include <thread>
 #include "cb_interface.h"
 #include "engine.h"
 #include "guiWindows.h"
@@ -38,17 +39,17 @@ bool inline Repetition(const uint64_t hashKey, uint64_t boardHashHistory[], int
 }
 
 // Principal Variation
-std::string SPrincipalVariation::ToString()
+std::string SPrincipalVariation::ToString(int maxMoves) const
 {
 	std::string ret;
-	for ( int i = 0; i < count; i++	)
+	for ( int i = 0; i < count && i < maxMoves; i++	)
 		ret += Transcript::GetMoveString(moves[i]) + "  ";
 
 	return ret;
 }
 
-// Do a move on the board, and also update the first layer neural network values
-int DoMove( const Move& move, SearchThreadData& search, int ply )
+// Do a move on the board, and record it so the first layer neural network values can be updated if the node is evaluated
+int DoMove( const Move& move, SearchThreadData& search, int ply, bool bPrefetchTT = false )
 {
 	SearchStackEntry* const stack = search.stack;
 	EvalNetInfo& netInfo = stack[ply].netInfo;
@@ -56,28 +57,88 @@ int DoMove( const Move& move, SearchThreadData& search, int ply )
 
 	int ret = board.DoMove(move);
 
+#ifdef TT_PREFETCH
+	// The new hashKey is known now, so start the (likely cache missing) load of the bucket. It overlaps the rest of
+	// the child setup, until the probe at the next ply.
+	if (bPrefetchTT) { engine.TTable.Prefetch(board.hashKey); }
+#endif
+
+	// Just record the move here, many nodes never get evaluated (tt cutoffs, interior nodes)
 	netInfo.netIdx = (int)CheckersNet::GetGamePhase(board);
-	if ( netInfo.netIdx >= 0 )
+	netInfo.firstLayerIdx = engine.evalNets[netInfo.netIdx]->firstLayerIdx;
+	netInfo.move = move;
+	netInfo.bValuesComputed = false;
+
+	return ret;
+}
+
+// Compute the first layer net values for stack[ply] without a parent to update from.
+// Near the game phase thresholds the path keeps switching nets, so start from the last position refreshed
+// for this net when fewer inputs differ than a full recompute would add.
+static void RefreshFirstLayerValues(SearchThreadData& search, int ply)
+{
+	const Board& board = search.stack[ply].board;
+	EvalNetInfo& netInfo = search.stack[ply].netInfo;
+	CheckersNet* net = engine.evalNets[netInfo.netIdx];
+	assert(netInfo.netIdx < kMaxEvalNets);
+	NetRefreshCache& cache = search.refreshCache[netInfo.firstLayerIdx];
+
+	const int fullInputCount = board.TotalPieces() + ((board.sideToMove == BLACK) ? 1 : 0);
+	if (engine.bUseNetRefreshCache && cache.bValid && CheckersNet::InputDifference(cache.bitboards, cache.sideToMove, board) < fullInputCount)
 	{
-		if (netInfo.netIdx == stack[ply-1].netInfo.netIdx)
-		{
-			// incrementally update first layer net values
-			memcpy( netInfo.firstLayerValues, stack[ply-1].netInfo.firstLayerValues, netInfo.valueCount * sizeof(nnInt_t));
-			engine.evalNets[netInfo.netIdx]->IncrementalUpdate(move, stack[ply-1].board, netInfo.firstLayerValues);
-
-			// Verify our values are an exact match
-		/*	nnInt_t firstLayerValues[kMaxValuesInLayer];
-			int numValues = engine.evalNets[netInfo.netIdx]->ComputeFirstLayerValues(board, search.nnValues, firstLayerValues);
-			for (int i = 0; i < numValues; i++)
-			{
-				assert(firstLayerValues[i] == netInfo.firstLayerValues[i]);
-			}*/
-		} else {
-			// fully recompute first layer net values
-			engine.evalNets[netInfo.netIdx]->ComputeFirstLayerValues(board, search.nnValues, netInfo.firstLayerValues);
-		}
+		net->UpdateFromPosition(cache.bitboards, cache.sideToMove, board, cache.firstLayerValues);
+		search.displayInfo.netCacheRefreshes++;
 	}
-	return ret;
+	else
+	{
+		// fully recompute first layer net values
+		net->ComputeFirstLayerValues(board, cache.firstLayerValues);
+		search.displayInfo.netFullRefreshes++;
+	}
+	cache.bitboards = board.Bitboards;
+	cache.sideToMove = board.sideToMove;
+	cache.bValid = true;
+
+	memcpy(netInfo.firstLayerValues, cache.firstLayerValues, netInfo.valueCount * sizeof(nnInt_t));
+	netInfo.bValuesComputed = true;
+}
+
+// Bring the first layer net values for stack[ply] up to date, by incrementally updating from the closest ancestor
+// that has computed values for the same net first layer. If there isn't one, refresh the values where this first layer
+// starts on the path, so siblings can update from there too.
+const EvalNetInfo& UpdateFirstLayerValues(SearchThreadData& search, int ply)
+{
+	SearchStackEntry* const stack = search.stack;
+	EvalNetInfo& netInfo = stack[ply].netInfo;
+	if (netInfo.bValuesComputed) return netInfo;
+
+	CheckersNet* net = engine.evalNets[netInfo.netIdx];
+	int start = ply;
+	while (start > 0 && !stack[start].netInfo.bValuesComputed && stack[start - 1].netInfo.firstLayerIdx == netInfo.firstLayerIdx) {
+		start--;
+	}
+
+	if (!stack[start].netInfo.bValuesComputed)
+	{
+		RefreshFirstLayerValues(search, start);
+	}
+
+	// incrementally update first layer net values along the path
+	for (int i = start + 1; i <= ply; i++)
+	{
+		EvalNetInfo& childInfo = stack[i].netInfo;
+		net->IncrementalUpdate(childInfo.move, stack[i - 1].board, stack[i - 1].netInfo.firstLayerValues, childInfo.firstLayerValues);
+		childInfo.bValuesComputed = true;
+	}
+
+	// Verify our values are an exact match
+/*	nnInt_t firstLayerValues[kMaxValuesInLayer];
+	int numValues = net->ComputeFirstLayerValues(stack[ply].board, firstLayerValues);
+	for (int i = 0; i < numValues; i++)
+	{
+		assert(firstLayerValues[i] == netInfo.firstLayerValues[i]);
+	}*/
+	return netInfo;
 }
 
 // -------------------------------------------------
@@ -97,7 +158,7 @@ int QuiesceBoard(SearchThreadData& search, int ply, int alpha, int beta )
 	{
 		search.displayInfo.selectiveDepth = std::max(search.displayInfo.selectiveDepth, ply-1 );
 
-		return inBoard.EvaluateBoard( ply-1, search, stack[ply-1].netInfo, 0 );
+		return inBoard.EvaluateBoard( ply-1, search, 0 );
 	}
 
 	// There are jump moves, so we keep searching. 
@@ -127,20 +188,37 @@ int QuiesceBoard(SearchThreadData& search, int ply, int alpha, int beta )
 
 	return alpha;
 }
+// -------------------------------------------------
+//  Time is checked every kTimeCheckNodes nodes, the node limit exactly so node limited searches are reproducible
+// -------------------------------------------------
+const uint64_t kTimeCheckNodes = 20000;
+
+inline void SetNextCheck(SearchThreadData& search)
+{
+	search.displayInfo.nextCheckNodes = search.displayInfo.nodes + kTimeCheckNodes;
+	if (engine.searchLimits.maxNodes > 0 && search.IsMainThread())
+		search.displayInfo.nextCheckNodes = std::min(search.displayInfo.nextCheckNodes, engine.searchLimits.maxNodes);
+}
+
 // -------------------------------------------------
 //  returns true if time has run out or the interface has asked the engine to stop the search
 // -------------------------------------------------
 inline bool CheckTimeUp(SearchThreadData& search)
 {
+	SetNextCheck(search);
+
+	// Helper threads keep searching until the main thread is done
+	if (!search.IsMainThread()) return engine.bStopHelpers;
+
 	// was the search asked to stop?
 	if (checkerBoard.bActive && *checkerBoard.pbPlayNow) return true;
 	if (engine.bStopThinking) return true;
-
-	search.displayInfo.nodesLastUpdate = search.displayInfo.nodes;
+	if (engine.searchLimits.maxNodes > 0 && search.displayInfo.nodes >= engine.searchLimits.maxNodes) return true;
 
 	// If time has run out, we allow running up to 2*Time if g_bEndHard == FALSE and we are still searching a depth
+	// While pondering there is no time limit, the search runs until the opponent moves
 	float elapsedTime = TimeSince(search.displayInfo.startTimeMs);
-	if (elapsedTime > engine.searchLimits.maxSeconds)
+	if (elapsedTime > engine.searchLimits.maxSeconds && !engine.bPondering)
 		if (elapsedTime > (2 * engine.searchLimits.maxSeconds * engine.searchLimits.panicExtraMult) || engine.searchLimits.bEndHard || search.displayInfo.searchingMove == 0 || abs(search.displayInfo.eval) > 1500)
 			return true;
 
@@ -159,7 +237,8 @@ inline void FirstPlyMoveUpdate(SearchThreadData& search, int newEval, Move bestm
 	search.displayInfo.searchingMove = movesSearched;
 
 	// On dramatic changes (such as fail lows) make sure to finish the iteration
-	if (abs(newEval) < 3000)
+	// MultiPV lines after the first are expected to score lower, they don't change the search eval
+	if (abs(newEval) < 3000 && search.multiPVCount == 0)
 	{
 		if (abs(newEval - search.displayInfo.eval) >= 26) engine.searchLimits.panicExtraMult = 1.8f;
 		if (abs(newEval - search.displayInfo.eval) >= 50) engine.searchLimits.panicExtraMult = 2.5f;
@@ -177,8 +256,8 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 {
 	assert(ply >= 1);
 	assert(beta > alpha);
-	// Check to see if move time has run out every 20000 nodes
-	if (search.displayInfo.nodes > search.displayInfo.nodesLastUpdate + 20000 )
+	// Check to see if move time has run out every kTimeCheckNodes nodes, or the node limit is reached
+	if (search.displayInfo.nodes >= search.displayInfo.nextCheckNodes)
 	{
 		if (CheckTimeUp(search)) return TIMEOUT;
 	}
@@ -204,10 +283,23 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 	// Find possible moves (and set a couple variables)
 	Board &board_in = stack[ply - 1].board;
 	const eColor color_in = board_in.sideToMove;
-	moveList.FindMoves(board_in);
 
-	if (moveList.numMoves == 0) { 
-		return -WinScore( ply - 1 ); // If you can't move, you've already lost the game
+	// Staged move generation : a legal predicted best move (from the TT or IID) is searched before the other moves
+	// are generated, so a cutoff on it skips generating them. Not at the root, where every move is searched anyway.
+	bool bFullMoveList = true;
+	search.displayInfo.moveGenNodes++;
+	if (engine.bUseStagedMoveGen && ply > 1 && predictedBestmove != NO_MOVE && moveList.FindMove(board_in, predictedBestmove))
+	{
+		bFullMoveList = false;
+	}
+	else
+	{
+		moveList.FindMoves(board_in);
+		search.displayInfo.fullMoveGens++;
+
+		if (moveList.numMoves == 0) { 
+			return -WinScore( ply - 1 ); // If you can't move, you've already lost the game
+		}
 	}
 	alpha = std::max(alpha, -WinScore(ply));
 	if (alpha >= beta) return alpha;
@@ -253,8 +345,18 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 	Move searchedMoves[MoveList::MAX_MOVES];
 	int movesSearched = 0;
 
-	for (int i = 0; i < moveList.numMoves; i++)
+	for (int i = 0; i < moveList.numMoves || !bFullMoveList; i++)
 	{
+		if (i == 1 && !bFullMoveList)
+		{
+			// The predicted move didn't cut off, so generate the rest. It is swapped to the front again, as already searched.
+			moveList.FindMoves(board_in);
+			moveList.SwapToFront(predictedBestmove);
+			search.displayInfo.fullMoveGens++;
+			bFullMoveList = true;
+			if (i >= moveList.numMoves) break;
+		}
+
 		if (i == sortOnMoveIdx) 
 		{
 			// Sort the remaining moves
@@ -263,8 +365,9 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 		}
 		
 		const Move move = moveList.moves[i];
+		if (ply == 1 && search.IsMultiPVMove(move)) { continue; }
 
-		if (ply == 1) 
+		if (ply == 1 && search.IsMainThread()) 
 		{
 			const int newEval = (color_in == WHITE) ? alpha : -alpha; // eval from red's POV
 			FirstPlyMoveUpdate( search, newEval, bestmove, movesSearched );
@@ -273,11 +376,11 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 		// Play the move (after resetting board to the one from previous ply)
         board = stack[ply-1].board;
 		const ePieceType movedPiece = board.GetPiece( move.Src() );
-        const int unreversible = DoMove(move, search, ply);
+        const int unreversible = DoMove(move, search, ply, engine.bUseHashTable && depth > 1);
 	
 		search.displayInfo.nodes++;
 
-		search.boardHashHistory[ engine.transcript.numMoves + ply] = board.hashKey;
+		search.boardHashHistory[ search.gameMoveCount + ply] = board.hashKey;
 		searchedMoves[movesSearched++] = move;
 		stack[ply].historyMoveIdx = search.historyTable.MoveIdx(move.Src(), move.Dir(0), movedPiece );
 		stack[ply + 1].pv.Clear();
@@ -304,7 +407,7 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 		{ 
 			value = 0;  // draw by 40-move rule value.. Not sure actual rules checkerboard calls draws this way sometimes though
 		}
-		else if (nextDepth >= 1 && ply > 1 && Repetition(board.hashKey, search.boardHashHistory, engine.transcript.numMoves + ply - board.reversibleMoves, engine.transcript.numMoves + ply))
+		else if (nextDepth >= 1 && ply > 1 && Repetition(board.hashKey, search.boardHashHistory, search.gameMoveCount + ply - board.reversibleMoves, search.gameMoveCount + ply))
 		{
 			value = 0; 	// If this is the repetition of a position that has occured already in the search, return a draw score
 		}
@@ -324,8 +427,15 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 			TEntry* ttEntry = nullptr;
 			if (engine.bUseHashTable)
 			{
+#ifdef TT_PROBE_TIMING
+				const uint64_t probeStartCycles = __rdtsc();
+#endif
 				ttEntry = engine.TTable.GetEntry( board, engine.ttAge );
-				ttEntry->Read( board.hashKey, alpha, beta, nextBestmove, value, boardEval, nextDepth, ply);
+				search.displayInfo.ttProbes++;
+				search.displayInfo.ttHits += ttEntry->Read( board.hashKey, alpha, beta, nextBestmove, value, boardEval, nextDepth, ply);
+#ifdef TT_PROBE_TIMING
+				search.displayInfo.ttProbeCycles += __rdtsc() - probeStartCycles;
+#endif
 				if (isPV && ply < 4) value = INVALID_VAL; // don't tt prune at beginning of PV, might miss repetition
 			}
 			if (value != INVALID_VAL && value <= alpha) { continue; }
@@ -335,7 +445,7 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 				// DATABASE : Stop searching if we know the exact value from the database
 				if (engine.dbInfo.InDatabase( board ) )
 				{
-					if (boardEval == INVALID_VAL) { boardEval = -board.EvaluateBoard(ply, search, stack[ply].netInfo, nextDepth); }
+					if (boardEval == INVALID_VAL) { boardEval = -board.EvaluateBoard(ply, search, nextDepth); }
 					if (boardEval == 0 || (engine.dbInfo.type == dbType::EXACT_VALUES && abs(boardEval) > MIN_WIN_SCORE) )
 						value = boardEval;
 				}
@@ -344,8 +454,8 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 				if (!isPV && value == INVALID_VAL && beta > -1500 && (!engine.dbInfo.loaded || board.TotalPieces() > engine.dbInfo.numPieces))
 				{
 					if (boardEval == INVALID_VAL) {
-						boardEval = -board.EvaluateBoard(ply, search, stack[ply].netInfo, nextDepth);
-						if (ttEntry) { ttEntry->m_boardEval = boardEval; }
+						boardEval = -board.EvaluateBoard(ply, search, nextDepth);
+						if (ttEntry) { ttEntry->WriteBoardEval(board.hashKey, boardEval); }
 					}
 
 					if (boardEval >= beta + kPruneEvalMargin)
@@ -389,7 +499,7 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 		if (ply == 1 && abs(value) < MIN_WIN_SCORE)
 		{
 			// Penalize moves at root that repeat positions, so hopefully the computer will always make progress if possible... 
-			if ( Repetition( board.hashKey, search.boardHashHistory, 0, engine.transcript.numMoves+1) ) value = (value>>1);
+			if ( Repetition( board.hashKey, search.boardHashHistory, 0, search.gameMoveCount+1) ) value = (value>>1);
 			else if (unreversible > 0 && value > alpha ) { value++; } // encourage moves that make progress...
 		}
 
@@ -410,7 +520,7 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 
 			if (isPV) {
 				stack[ply].pv.Set(bestmove, stack[ply + 1].pv); // Save the pv for display/debugging
-				if (ply == 1) {search.displayInfo.pv = stack[ply].pv;}
+				if (ply == 1 && search.multiPVCount == 0) {search.displayInfo.pv = stack[ply].pv;}
 			}
 		}
 	} // end move loop
@@ -423,6 +533,118 @@ int ABSearch( SearchThreadData& search, int32_t ply, int32_t depth, int32_t alph
 	return alpha;
 }
 
+// -------------------------------------------------
+// Lazy SMP helper thread search. Iteratively deepens on the root position until the main thread stops it.
+// The result is not used directly, the helpers just fill the shared transposition table for the main thread.
+// Odd numbered helpers search the odd depths so the threads are spread over different depths.
+// -------------------------------------------------
+void HelperThreadSearch(Board rootBoard, SearchThreadData& search)
+{
+	Move bestmove = NO_MOVE;
+	int lastEval = 0;
+
+	search.stack[0].board = rootBoard;
+	search.stack[0].board.hashKey = rootBoard.CalcHashKey();
+
+	for (int depth = 2 + (search.threadIdx & 1); depth <= engine.searchLimits.maxDepth && !engine.bStopHelpers; depth += 2)
+	{
+		search.displayInfo.depth = depth;
+
+		int windowDelta = (depth < 8) ? 4000 : (20 + abs(lastEval) / 8);
+		while (true)
+		{
+			const int alpha = lastEval - windowDelta;
+			const int beta = lastEval + windowDelta;
+
+			const int eval = ABSearch(search, 1, depth, alpha, beta, true, bestmove);
+			if (eval == TIMEOUT) return;
+
+			lastEval = eval;
+			if (lastEval > alpha && lastEval < beta) { break; }
+
+			windowDelta *= 2;
+			if (windowDelta > 300) { windowDelta = 4000; }
+		}
+	}
+}
+
+// Reset the helper thread data from the main thread and start the helper threads searching
+static void StartHelperThreads(const Board& rootBoard, const SearchThreadData& mainSearch, std::vector<std::thread>& threads)
+{
+	engine.bStopHelpers = false;
+	for (auto helper : engine.helperThreadData)
+	{
+		helper->displayInfo.Reset();
+		helper->displayInfo.startTimeMs = mainSearch.displayInfo.startTimeMs;
+		SetNextCheck(*helper);
+		helper->ClearStack();
+		helper->stack[0].netInfo.netIdx = -1;
+		helper->stack[0].netInfo.firstLayerIdx = -1;
+		memcpy(helper->boardHashHistory, mainSearch.boardHashHistory, sizeof(helper->boardHashHistory));
+		helper->gameMoveCount = mainSearch.gameMoveCount;
+
+		threads.emplace_back(HelperThreadSearch, rootBoard, std::ref(*helper));
+	}
+}
+
+static void StopHelperThreads(std::vector<std::thread>& threads)
+{
+	engine.bStopHelpers = true;
+	for (auto& thread : threads) { thread.join(); }
+	threads.clear();
+}
+
+// -------------------------------------------------
+// MultiPV : search the root once per line with a full window, each search skipping the moves ranked before it.
+// If time runs out, the lines from the previous depth fill in after the ones completed at this depth.
+// returns the eval of the best line, or TIMEOUT if even that search did not finish
+// -------------------------------------------------
+static int MultiPVSearch(SearchThreadData& search, int depth, int lineCount, Move& bestmove)
+{
+	MultiPVLine prevLines[MoveList::MAX_MOVES];
+	const int prevCount = search.multiPVCount;
+	memcpy(prevLines, search.multiPVLines, sizeof(MultiPVLine) * prevCount);
+
+	const eColor rootColor = search.stack[0].board.sideToMove;
+	int bestEval = TIMEOUT;
+	search.multiPVCount = 0;
+	while (search.multiPVCount < lineCount)
+	{
+		Move lineMove = NO_MOVE;
+		const int eval = ABSearch(search, 1, depth, -WinScore(0), WinScore(0), true, (search.multiPVCount == 0) ? bestmove : lineMove);
+		if (eval == TIMEOUT) break;
+
+		MultiPVLine& line = search.multiPVLines[search.multiPVCount++];
+		line.eval = eval;
+		line.depth = depth;
+		line.pv = search.stack[1].pv;
+		if (search.multiPVCount == 1) {
+			bestEval = eval;
+			search.displayInfo.pv = line.pv;
+		}
+	}
+
+	// Searches of later lines use the table entries of earlier ones, so a later line can score a little higher.
+	// Keep the best line first since it is the move played, and rank the rest by eval.
+	std::stable_sort(search.multiPVLines + 1, search.multiPVLines + search.multiPVCount,
+		[](const MultiPVLine& a, const MultiPVLine& b) { return a.eval > b.eval; });
+	for (int i = 0; i < search.multiPVCount; i++) {
+		search.multiPVLines[i].eval = (rootColor == BLACK) ? -search.multiPVLines[i].eval : search.multiPVLines[i].eval;
+	}
+
+	for (int i = 0; i < prevCount && search.multiPVCount < prevCount; i++)
+	{
+		if (!search.IsMultiPVMove(prevLines[i].pv.moves[0])) {
+			search.multiPVLines[search.multiPVCount++] = prevLines[i];
+		}
+	}
+	if (bestEval == TIMEOUT && prevCount > 0) {
+		search.displayInfo.pv = search.multiPVLines[0].pv;
+	}
+
+	return bestEval;
+}
+
 // -------------------------------------------------
 // The computer calculates a move then updates g_Board.
 // returns the search eval relative to the side to move
@@ -433,6 +655,7 @@ BestMoveInfo ComputerMove( Board &InBoard, SearchThreadData& search )
 	Move bestmove = NO_MOVE;
 	Move doMove = NO_MOVE;
 	engine.ttAge = (engine.ttAge + 1) & 63; // fit into 6 bits to store in tt
+	engine.TTable.SetFileAge(engine.ttAge);
 	
 	MoveList& moveList = search.stack[1].moveList;
 
@@ -446,9 +669,13 @@ BestMoveInfo ComputerMove( Board &InBoard, SearchThreadData& search )
 	search.displayInfo.Reset();
 	search.displayInfo.startTimeMs = GetCurrentTimeMs();
 	search.displayInfo.numMoves = moveList.numMoves;
+	SetNextCheck(search);
 	search.ClearStack();
 	search.stack[0].netInfo.netIdx = -1; // Set to invalid net to force initial computation
+	search.stack[0].netInfo.firstLayerIdx = -1;
 	memcpy(search.boardHashHistory, engine.boardHashHistory, sizeof(search.boardHashHistory));
+	search.gameMoveCount = engine.transcript.numMoves;
+	search.multiPVCount = 0;
 	search.displayInfo.eval = BOOK_INVALID_VALUE;
 	if (checkerBoard.useOpeningBook != CB_BOOK_NONE)
 		search.displayInfo.eval = engine.openingBook->GetMove( InBoard, bestmove );
@@ -459,10 +686,21 @@ BestMoveInfo ComputerMove( Board &InBoard, SearchThreadData& search )
 	if (search.displayInfo.eval == BOOK_INVALID_VALUE)
 	{
 		// Make sure the repetition tester has all the values needed.
-		if (!checkerBoard.bActive) {
+		if (!checkerBoard.bActive && engine.bPondering) {
+			// The ponder board is one move past the end of the transcript
+			Board gameBoard;
+			engine.transcript.ReplayGame(gameBoard, search.boardHashHistory);
+			search.boardHashHistory[search.gameMoveCount++] = gameBoard.hashKey;
+		} else if (!checkerBoard.bActive) {
 			engine.transcript.ReplayGame(InBoard, search.boardHashHistory );
 		}
 
+		std::vector<std::thread> helperThreads;
+		StartHelperThreads(InBoard, search, helperThreads);
+
+		const int multiPVLineCount = std::min(engine.searchLimits.multiPV, search.displayInfo.numMoves);
+		const bool bMultiPV = multiPVLineCount > 1;
+
 		// Initialize search depth
 		int depth = (engine.searchLimits.maxDepth < 4) ? engine.searchLimits.maxDepth : 2;
 		int Eval = 0;
@@ -477,13 +715,18 @@ BestMoveInfo ComputerMove( Board &InBoard, SearchThreadData& search )
 			search.stack[0].board.hashKey = InBoard.CalcHashKey();
 
 			// search with an aspiration window, will expand window and re-search if value is outside of it
+			// MultiPV searches always use a full window, so each line gets an exact eval
 			int windowDelta = (depth < 8 ) ? 4000 : (20 + abs(Eval) / 8);
 			while (true)
 			{
-				const int alpha = LastEval - windowDelta;
-				const int beta = LastEval + windowDelta;
+				const int alpha = bMultiPV ? -WinScore(0) : LastEval - windowDelta;
+				const int beta = bMultiPV ? WinScore(0) : LastEval + windowDelta;
 
-				Eval = ABSearch(search, 1, depth, alpha, beta, true, bestmove);
+				if (bMultiPV) {
+					Eval = MultiPVSearch(search, depth, multiPVLineCount, bestmove);
+				} else {
+					Eval = ABSearch(search, 1, depth, alpha, beta, true, bestmove);
+				}
 				if (bestmove != NO_MOVE) doMove = bestmove;
 
 				if (Eval != TIMEOUT)
@@ -494,7 +737,7 @@ BestMoveInfo ComputerMove( Board &InBoard, SearchThreadData& search )
 
 					// Check if there is only one legal move, if so don't keep searching
 					if (moveList.numMoves == 1 && engine.searchLimits.maxDepth > 6) { Eval = TIMEOUT; }
-					if (elapsedTime > engine.searchLimits.maxSeconds * .7f  // probably won't get any useful info before timeup
+					if ((elapsedTime > engine.searchLimits.maxSeconds * .7f && !engine.bPondering) // probably won't get any useful info before timeup
 						|| (abs(Eval) > WinScore(depth) )) // found a win, can stop searching now) 
 					{
 						Eval = TIMEOUT;
@@ -516,6 +759,8 @@ BestMoveInfo ComputerMove( Board &InBoard, SearchThreadData& search )
 				if (windowDelta > 300) { windowDelta = 4000; }
 			}
 		}
+
+		StopHelperThreads(helperThreads);
 	}
 
 	if (checkerBoard.bActive && doMove == NO_MOVE) {
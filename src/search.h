@@ -13,7 +13,9 @@ struct BestMoveInfo
 };
 
 BestMoveInfo ComputerMove(Board& InBoard, struct SearchThreadData& search);
+void HelperThreadSearch(Board rootBoard, struct SearchThreadData& search);
 bool Repetition(const uint64_t hashKey, uint64_t boardHashHistory[], int start, int end);
+const struct EvalNetInfo& UpdateFirstLayerValues(struct SearchThreadData& search, int ply);
 
 // Keep track of principal variation moves for display and debugging
 struct SPrincipalVariation
@@ -43,7 +45,15 @@ struct SPrincipalVariation
 		}
 	}
 
-	std::string ToString();
+	std::string ToString(int maxMoves = MAX_SEARCHDEPTH) const;
+};
+
+// One ranked root move of a MultiPV search
+struct MultiPVLine
+{
+	int eval; // same point of view as SearchInfo::eval
+	int depth;
+	SPrincipalVariation pv;
 };
 
 struct EvalNetInfo
@@ -53,6 +63,48 @@ struct EvalNetInfo
 	int valueCount;
 	// Need to know which eval net the values are for too
 	int netIdx = -1; 
+	int firstLayerIdx = -1; // nets with the same first layer can update each other's values
+	// The values are updated lazily : DoMove only records the move, and UpdateFirstLayerValues computes the values when an eval needs them
+	Move move = NO_MOVE;
+	bool bValuesComputed = false;
+};
+
+// Last first layer values computed from scratch for each eval net first layer, with the position they are for.
+// When the path switches nets we update these by the difference in pieces instead of starting from the biases.
+const int kMaxEvalNets = 4;
+struct NetRefreshCache
+{
+	nnInt_t* firstLayerValues = nullptr;
+	CheckerBitboards bitboards;
+	eColor sideToMove;
+	bool bValid = false;
+};
+
+// Small direct mapped cache of net evals by hashKey, one for each search thread, for positions the search reaches again
+// through transpositions and re-searches. It's lossy : a store just replaces whatever was in the slot.
+// Each entry is a tag from the upper 32 bits of the hashKey, with the eval in the lower 32 bits. The slot is from the low bits.
+// The tag always has its low bit set, so a cleared entry never matches.
+const int kEvalCacheEntries = 1 << 14; // 128 KB, stays in L2
+struct EvalCache
+{
+	uint64_t* entries = nullptr;
+
+	static inline uint32_t Tag(uint64_t hashKey) { return (uint32_t)(hashKey >> 32) | 1; }
+
+	inline bool Probe(uint64_t hashKey, int& eval) const
+	{
+		const uint64_t entry = entries[hashKey & (kEvalCacheEntries - 1)];
+		if ((uint32_t)(entry >> 32) != Tag(hashKey)) return false;
+		eval = (int32_t)(uint32_t)entry;
+		return true;
+	}
+
+	inline void Store(uint64_t hashKey, int eval)
+	{
+		entries[hashKey & (kEvalCacheEntries - 1)] = ((uint64_t)Tag(hashKey) << 32) | (uint32_t)eval;
+	}
+
+	void Clear() { memset(entries, 0, kEvalCacheEntries * sizeof(uint64_t)); }
 };
 
 //
@@ -78,6 +130,8 @@ struct SearchLimits
 	float panicExtraMult;
 	bool bEndHard = false;					// Set to true to stop search after fMaxSeconds no matter what.
 	int maxDepth = EXPERT_DEPTH;
+	int multiPV = 1;						// Number of best root moves to search with full windows and report, 1 for a normal search
+	uint64_t maxNodes = 0;					// Stop when the main thread has searched this many nodes, 0 for no limit. Reproducible with one thread.
 };
 
 //
@@ -88,8 +142,18 @@ struct SearchInfo
 	uint64_t startTimeMs;
 	uint64_t lastDisplayTimeMs;
 	uint64_t nodes;
-	uint64_t nodesLastUpdate;
+	uint64_t nextCheckNodes; // node count of the next time and node limit check
 	uint64_t databaseNodes;
+	uint64_t ttProbes;
+	uint64_t ttHits;
+	uint64_t ttProbeCycles; // only counted with TT_PROBE_TIMING
+	uint64_t netFullRefreshes;
+	uint64_t netCacheRefreshes;
+	uint64_t evalCacheProbes;
+	uint64_t evalCacheHits;
+	uint64_t netEvalCycles; // only counted with EVAL_TIMING
+	uint64_t moveGenNodes; // nodes that needed moves
+	uint64_t fullMoveGens; // nodes that generated all their moves, the others were cut off by a staged predicted move
 	int32_t depth;
 	int32_t selectiveDepth;
 	int searchingMove;
@@ -104,32 +168,57 @@ struct SearchInfo
 };
 
 // Store in structure passed to search function for multi-threading support
+// Thread 0 is the main search thread, the others are lazy SMP helpers that only share the transposition table.
 struct SearchThreadData
 {
+	int threadIdx = 0;
+	inline bool IsMainThread() const { return threadIdx == 0; }
+
 	SearchStackEntry stack[MAX_SEARCHDEPTH + 1];
 	SearchInfo displayInfo;
 	uint64_t boardHashHistory[MAX_GAMEMOVES];
+	int gameMoveCount = 0; // game moves played before the search root, the search adds its positions to boardHashHistory after them
 
 	HistoryTable historyTable;
-	nnInt_t* nnValues = nullptr;
+	NetRefreshCache refreshCache[kMaxEvalNets];
+	EvalCache evalCache;
+
+	// MultiPV : root moves ranked so far in this iteration, best first. The root skips them when searching for the next line.
+	MultiPVLine multiPVLines[MoveList::MAX_MOVES];
+	int multiPVCount = 0;
+
+	inline bool IsMultiPVMove(const Move& move) const
+	{
+		for (int i = 0; i < multiPVCount; i++) {
+			if (multiPVLines[i].pv.moves[0] == move) return true;
+		}
+		return false;
+	}
 
 	~SearchThreadData()
 	{
-		if (nnValues) { AlignedFreeUtil(nnValues); }
 		for (int i = 0; i < MAX_SEARCHDEPTH + 1; i++)
 		{
 			 AlignedFreeUtil(stack[i].netInfo.firstLayerValues);
 		}
+		for (auto& cache : refreshCache) { AlignedFreeUtil(cache.firstLayerValues); }
+		AlignedFreeUtil(evalCache.entries);
 	}
 
 	void Alloc( int firstLayerSize )
 	{
-		nnValues = AlignedAllocUtil<nnInt_t>(kMaxEvalNetValues, 64);
 		for (int i = 0; i < MAX_SEARCHDEPTH + 1; i++)
 		{
 			stack[i].netInfo.valueCount = firstLayerSize;
 			stack[i].netInfo.firstLayerValues = AlignedAllocUtil<nnInt_t>(firstLayerSize, 64);
 		}
+		for (auto& cache : refreshCache)
+		{
+			cache.firstLayerValues = AlignedAllocUtil<nnInt_t>(firstLayerSize, 64);
+			cache.bValid = false;
+		}
+		evalCache.entries = AlignedAllocUtil<uint64_t>(kEvalCacheEntries, 64);
+		evalCache.Clear();
 	}
 
 	void ClearStack()
@@ -139,7 +228,11 @@ struct SearchThreadData
 			stack[i].killerMove = NO_MOVE;
 			stack[i].moveList.Clear();
 			stack[i].pv.Clear();
+			stack[i].netInfo.bValuesComputed = false;
 		}
+		// the nets may have been reloaded or switched to int8 since the last search
+		for (auto& cache : refreshCache) { cache.bValid = false; }
+		evalCache.Clear();
 	}
 };
 
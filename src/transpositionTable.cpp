@@ -0,0 +1,417 @@
+//
+// transpositionTable.cpp
+//
+// Allocation and clearing of the transposition table memory.
+// The table is allocated with large pages when the OS allows it, since random probes over a big table
+// otherwise miss the TLB on almost every access. Falls back to regular pages.
+// The table can instead be mapped to a file, so analysis can continue from it in a later session.
+// An existing file is used in place, so reloading it doesn't copy anything.
+//
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "engine.h"
+
+static size_t SystemPageSize()
+{
+#ifdef _WIN32
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	return systemInfo.dwPageSize;
+#else
+	return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+#ifdef _WIN32
+// Large pages need the "Lock pages in memory" privilege, which the user has to be granted by an admin
+static bool EnableLockMemoryPrivilege()
+{
+	HANDLE token;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		return false;
+
+	TOKEN_PRIVILEGES privileges = {};
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	bool bEnabled = false;
+	if (LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid))
+	{
+		// AdjustTokenPrivileges can succeed without assigning the privilege, so also check the last error
+		bEnabled = AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+	}
+	CloseHandle(token);
+	return bEnabled;
+}
+#endif
+
+// Allocate memory for the table, sets allocBytes and pageSize. Returns nullptr on failure.
+void* TranspositionTable::AllocTableMemory(size_t bytes)
+{
+	void* mem = nullptr;
+#ifdef _WIN32
+	const size_t largePageSize = GetLargePageMinimum();
+	if (largePageSize > 0 && EnableLockMemoryPrivilege())
+	{
+		const size_t largeBytes = (bytes + largePageSize - 1) & ~(largePageSize - 1);
+		mem = VirtualAlloc(nullptr, largeBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (mem != nullptr)
+		{
+			allocBytes = largeBytes;
+			pageSize = largePageSize;
+			return mem;
+		}
+	}
+
+	mem = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	allocBytes = bytes;
+	pageSize = SystemPageSize();
+#else
+	// Explicit huge pages only work if the admin reserved some (vm.nr_hugepages)
+	const size_t hugePageSize = 2 * 1024 * 1024;
+	const size_t hugeBytes = (bytes + hugePageSize - 1) & ~(hugePageSize - 1);
+#ifdef MAP_HUGETLB
+	mem = mmap(nullptr, hugeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (mem != MAP_FAILED)
+	{
+		allocBytes = hugeBytes;
+		pageSize = hugePageSize;
+		bHugePagesRequested = false;
+		return mem;
+	}
+#endif
+
+	// Otherwise ask for transparent huge pages, which the kernel may or may not give us when the memory is touched.
+	// They can only back 2 MB aligned memory, so map an extra huge page and trim the ends.
+	uint8_t* const raw = (uint8_t*)mmap(nullptr, hugeBytes + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		return nullptr;
+	uint8_t* const aligned = (uint8_t*)(((uintptr_t)raw + hugePageSize - 1) & ~(uintptr_t)(hugePageSize - 1));
+	if (aligned > raw)
+		munmap(raw, aligned - raw);
+	if (raw + hugePageSize > aligned)
+		munmap(aligned + hugeBytes, raw + hugePageSize - aligned);
+	mem = aligned;
+	allocBytes = hugeBytes;
+	pageSize = SystemPageSize();
+	bHugePagesRequested = false;
+#ifdef MADV_HUGEPAGE
+	bHugePagesRequested = (madvise(mem, hugeBytes, MADV_HUGEPAGE) == 0);
+#endif
+#endif
+	return mem;
+}
+
+void TranspositionTable::FreeTableMemory()
+{
+	if (!filePath.empty())
+	{
+		UnmapFile();
+	}
+	else if (buckets != nullptr)
+	{
+#ifdef _WIN32
+		VirtualFree(buckets, 0, MEM_RELEASE);
+#else
+		munmap(buckets, allocBytes);
+#endif
+	}
+	buckets = nullptr;
+	numBuckets = 0;
+	allocBytes = 0;
+}
+
+// Allocate the hashtable.
+// returns true if successful
+bool TranspositionTable::SetSizeMB(int _sizeMb)
+{
+	FreeTableMemory();
+
+	sizeMb = _sizeMb;
+	numBuckets = ((size_t)sizeMb * (1 << 20)) / sizeof(TBucket);
+	buckets = (TBucket*)AllocTableMemory(numBuckets * sizeof(TBucket));
+	if (buckets == nullptr)
+	{
+		numBuckets = 0;
+		return false;
+	}
+	Clear();
+	return true;
+}
+
+// Zero the table. Large tables are split over threads, since a single thread can't saturate memory bandwidth.
+void TranspositionTable::Clear()
+{
+	const size_t kMinBucketsPerThread = (16 << 20) / sizeof(TBucket);
+	const size_t numThreads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), std::max<size_t>(numBuckets / kMinBucketsPerThread, 1));
+	if (numThreads <= 1)
+	{
+		memset(buckets, 0, sizeof(TBucket) * numBuckets);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	const size_t bucketsPerThread = (numBuckets + numThreads - 1) / numThreads;
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		const size_t start = i * bucketsPerThread;
+		const size_t count = std::min(bucketsPerThread, numBuckets - start);
+		threads.emplace_back([this, start, count]() { memset(&buckets[start], 0, sizeof(TBucket) * count); });
+	}
+	for (auto& thread : threads) { thread.join(); }
+}
+
+#ifndef _WIN32
+// Bytes of the mapping holding mem that the kernel backs with transparent huge pages, from /proc/self/smaps
+static size_t TransparentHugePageBytes(const void* mem)
+{
+	FILE* file = fopen("/proc/self/smaps", "r");
+	if (file == nullptr)
+		return 0;
+
+	char line[256];
+	bool bInMapping = false;
+	size_t hugeBytes = 0;
+	while (fgets(line, sizeof(line), file))
+	{
+		// Each mapping starts with its address range, followed by lines of its stats
+		unsigned long long start, end;
+		if (sscanf(line, "%llx-%llx ", &start, &end) == 2)
+		{
+			bInMapping = ((uintptr_t)mem >= start && (uintptr_t)mem < end);
+			continue;
+		}
+		unsigned long long kb;
+		if (bInMapping && sscanf(line, "AnonHugePages: %llu kB", &kb) == 1)
+		{
+			hugeBytes = (size_t)kb * 1024;
+			break;
+		}
+	}
+	fclose(file);
+	return hugeBytes;
+}
+#endif
+
+std::string TranspositionTable::PageSizeString() const
+{
+	const std::string size = (pageSize >= (1 << 20)) ? std::to_string(pageSize >> 20) + " MB" : std::to_string(pageSize >> 10) + " KB";
+	if (IsFileMapped())
+		return size + " pages (mapped file)";
+
+#ifndef _WIN32
+	// Asking for transparent huge pages doesn't mean we got them, so report what the kernel actually gave the table
+	if (bHugePagesRequested)
+	{
+		const size_t hugeBytes = std::min(TransparentHugePageBytes(buckets), allocBytes);
+		if (hugeBytes == 0)
+			return size + " pages (2 MB requested)";
+		return "2 MB pages (transparent, " + std::to_string(hugeBytes * 100 / allocBytes) + "% of the table)";
+	}
+#endif
+	return size + " pages";
+}
+
+static const char kTTFileMagic[8] = "GUINNTT";
+#ifdef LOCKLESS_TT
+static const uint32_t kTTFileFlags = 1;
+#else
+static const uint32_t kTTFileFlags = 0;
+#endif
+
+// A fingerprint of the hash function, since entries hashed with a different function are useless
+uint64_t TranspositionTable::HashFunctionVersion()
+{
+	uint64_t version = HashSTM;
+	for (int sq = 0; sq < NUM_BOARD_SQUARES; sq++)
+		for (int piece = 0; piece < NUM_PIECE_TYPES; piece++)
+			version = (version ^ HashFunction[sq][piece]) * 0x100000001B3ULL;
+	return version;
+}
+
+void TranspositionTable::FillFileHeader()
+{
+	memset(fileHeader, 0, sizeof(TTFileHeader));
+	memcpy(fileHeader->magic, kTTFileMagic, sizeof(kTTFileMagic));
+	fileHeader->fileVersion = kTTFileVersion;
+	fileHeader->bucketBytes = sizeof(TBucket);
+	fileHeader->entriesPerBucket = ENTRIES_PER_BUCKET;
+	fileHeader->flags = kTTFileFlags;
+	fileHeader->hashFunctionVersion = HashFunctionVersion();
+	fileHeader->numBuckets = numBuckets;
+	fileHeader->sizeMb = fileSizeMb;
+}
+
+bool TranspositionTable::IsFileHeaderValid(size_t fileBytes) const
+{
+	return memcmp(fileHeader->magic, kTTFileMagic, sizeof(kTTFileMagic)) == 0
+		&& fileHeader->fileVersion == kTTFileVersion
+		&& fileHeader->bucketBytes == sizeof(TBucket)
+		&& fileHeader->entriesPerBucket == ENTRIES_PER_BUCKET
+		&& fileHeader->flags == kTTFileFlags
+		&& fileHeader->hashFunctionVersion == HashFunctionVersion()
+		&& fileHeader->numBuckets > 0
+		&& fileBytes == sizeof(TTFileHeader) + fileHeader->numBuckets * sizeof(TBucket);
+}
+
+// Map a view of the open file, first resizing the file if bResize. Sets allocBytes. Returns nullptr on failure.
+void* TranspositionTable::MapFileView(size_t bytes, bool bResize)
+{
+	void* view = nullptr;
+#ifdef _WIN32
+	if (bResize)
+	{
+		LARGE_INTEGER size;
+		size.QuadPart = (LONGLONG)bytes;
+		if (!SetFilePointerEx(fileHandle, size, nullptr, FILE_BEGIN) || !SetEndOfFile(fileHandle))
+			return nullptr;
+	}
+	fileMapping = CreateFileMapping(fileHandle, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32), (DWORD)bytes, nullptr);
+	if (fileMapping == nullptr)
+		return nullptr;
+	view = MapViewOfFile(fileMapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+#else
+	if (bResize && ftruncate(fileDescriptor, (off_t)bytes) != 0)
+		return nullptr;
+	view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+	if (view == MAP_FAILED)
+		view = nullptr;
+#endif
+	if (view != nullptr)
+		allocBytes = bytes;
+	return view;
+}
+
+// Map the table to a file. If the file already holds a table from a compatible build it's used as is, with its size.
+// Otherwise a new table of _sizeMb is created in the file. returns true if successful
+bool TranspositionTable::MapFile(const std::string& path, int _sizeMb, bool& bReloaded, std::string& error)
+{
+	FreeTableMemory();
+	bReloaded = false;
+	error = "could not map the file";
+	filePath = path;
+
+	size_t fileBytes = 0;
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		FreeTableMemory();
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(fileHandle, &size))
+		fileBytes = (size_t)size.QuadPart;
+#else
+	fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fileDescriptor < 0)
+	{
+		FreeTableMemory();
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) == 0)
+		fileBytes = (size_t)fileStat.st_size;
+#endif
+	pageSize = SystemPageSize();
+	bHugePagesRequested = false;
+
+	// Reuse an existing table in place. A table from another build or of another size is replaced, but any other
+	// file is left alone, so a wrong path can't overwrite a game or net file.
+	if (fileBytes > 0)
+	{
+		bool bHashFile = false;
+		if (fileBytes > sizeof(TTFileHeader))
+		{
+			fileHeader = (TTFileHeader*)MapFileView(fileBytes, false);
+			if (fileHeader != nullptr && IsFileHeaderValid(fileBytes))
+			{
+				buckets = (TBucket*)(fileHeader + 1);
+				numBuckets = fileHeader->numBuckets;
+				fileSizeMb = fileHeader->sizeMb;
+				bReloaded = true;
+				return true;
+			}
+			bHashFile = (fileHeader != nullptr && memcmp(fileHeader->magic, kTTFileMagic, sizeof(kTTFileMagic)) == 0);
+			UnmapFileView();
+		}
+		if (!bHashFile)
+		{
+			FreeTableMemory();
+			error = "not a hash file";
+			return false;
+		}
+	}
+
+	// Create a new table in the file
+	fileSizeMb = _sizeMb;
+	numBuckets = ((size_t)fileSizeMb * (1 << 20)) / sizeof(TBucket);
+	fileHeader = (TTFileHeader*)MapFileView(sizeof(TTFileHeader) + numBuckets * sizeof(TBucket), true);
+	if (fileHeader == nullptr)
+	{
+		FreeTableMemory();
+		return false;
+	}
+	buckets = (TBucket*)(fileHeader + 1);
+	Clear();
+	FillFileHeader();
+	return true;
+}
+
+// Write the mapped table out to disk now, instead of whenever the OS gets to it
+void TranspositionTable::FlushFile()
+{
+	if (!IsFileMapped())
+		return;
+#ifdef _WIN32
+	FlushViewOfFile(fileHeader, 0);
+	FlushFileBuffers(fileHandle);
+#else
+	msync(fileHeader, allocBytes, MS_SYNC);
+#endif
+}
+
+void TranspositionTable::UnmapFileView()
+{
+#ifdef _WIN32
+	if (fileHeader != nullptr)
+		UnmapViewOfFile(fileHeader);
+	if (fileMapping != nullptr)
+		CloseHandle(fileMapping);
+	fileMapping = nullptr;
+#else
+	if (fileHeader != nullptr)
+		munmap(fileHeader, allocBytes);
+#endif
+	fileHeader = nullptr;
+	buckets = nullptr;
+}
+
+void TranspositionTable::UnmapFile()
+{
+	FlushFile();
+	UnmapFileView();
+#ifdef _WIN32
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+	fileHandle = nullptr;
+#else
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	filePath.clear();
+	fileSizeMb = 0;
+}
@@ -3,13 +3,19 @@
 // by Jonathan Kreuzer
 //
 // TEntry - single entry in the tranposition table, storing the usual info (searchEval, depth, best-move, etc.)
+// TBucket - a 64 byte cache line of entries, so a probe only touches one line of memory
 // TranspositionTable - a table of entries and related functionality
+// TTFileHeader - header of a table mapped to a file, so it persists between sessions
+//
+// With LOCKLESS_TT the stored checksum is xor'd with the rest of the entry data, so the table can be shared by the
+// search threads without locks. An entry torn by two threads writing at once won't validate, and is just a miss.
 //
 #pragma once
 
 #include <stdlib.h> 
 #include <cstring>
 #include <string>
+#include <xmmintrin.h>
 
 #include "defines.h"
 
@@ -17,27 +23,57 @@ struct TEntry
 {
 	enum eFailType { TT_EXACT, TT_FAIL_LOW, TT_FAIL_HIGH };
 
+	// The checksum is the top 15 bits of the hashKey, with the low bit set so it's never 0. The low bits of the hashKey
+	// already picked the bucket. A cleared entry has a checksum of 0, so it's empty and never matches a board.
+	static inline uint16_t HashChecksum(uint64_t hashKey) { return (uint16_t)(hashKey >> 48) | 1; }
+
+	// The data that is xor'd into the stored checksum
+	inline uint16_t DataKey() const
+	{
+#ifdef LOCKLESS_TT
+		const uint32_t key = m_bestmove.data 
+			^ ((uint32_t)(uint16_t)m_searchEval | ((uint32_t)(uint16_t)m_boardEval << 16)) 
+			^ ((uint32_t)(uint8_t)m_depth | ((uint32_t)m_ageAndFailtype << 8));
+		return (uint16_t)(key ^ (key >> 16));
+#else
+		return 0;
+#endif
+	}
+	inline uint16_t Checksum() const { return m_checksum ^ DataKey(); }
+	inline bool IsEmpty() const { return Checksum() == 0; }
+
 	bool inline IsBoard(uint64_t hashKey) const
 	{
-		return m_checksum == (hashKey >> 32);
+		return Checksum() == HashChecksum(hashKey);
 	}
-	void inline Read(uint64_t boardHash, short alpha, short beta, Move& bestmove, int& value, int& boardEval, int depth, int ahead)
+
+	// Copy the entry once before using it, since another thread may be writing it
+	inline TEntry Load() const
+	{
+		TEntry entry;
+		memcpy(&entry, this, sizeof(TEntry));
+		return entry;
+	}
+
+	// Returns true if the entry is for this board
+	bool inline Read(uint64_t boardHash, short alpha, short beta, Move& bestmove, int& value, int& boardEval, int depth, int ahead) const
 	{
-		if (m_checksum == (boardHash >> 32)) // To be almost totally sure these are really the same position.  
+		const TEntry entry = Load();
+		if (entry.IsBoard(boardHash)) // To be almost totally sure these are really the same position.  
 		{
 			// Get the Value if the search was deep enough, and bounds usable
-			if (m_depth >= depth)
+			if (entry.m_depth >= depth)
 			{
-				int tempVal = m_searchEval;
+				int tempVal = entry.m_searchEval;
 				// This is a game ending value, must adjust it since it depends on the variable ahead
-				if (m_searchEval > MIN_WIN_SCORE) {
-					tempVal = m_searchEval - ahead;
+				if (entry.m_searchEval > MIN_WIN_SCORE) {
+					tempVal = entry.m_searchEval - ahead;
 				}
-				if (m_searchEval < -MIN_WIN_SCORE) {
-					tempVal = m_searchEval + ahead;
+				if (entry.m_searchEval < -MIN_WIN_SCORE) {
+					tempVal = entry.m_searchEval + ahead;
 				}
 
-				switch (FailType())
+				switch (entry.FailType())
 				{
 				case TT_EXACT: 
 					value = tempVal;
@@ -51,48 +87,65 @@ struct TEntry
 				}
 			}
 			// Take the best move from Transposition Table                                                
-			bestmove = m_bestmove;
-			boardEval = m_boardEval;
+			bestmove = entry.m_bestmove;
+			boardEval = entry.m_boardEval;
+			return true;
 		}
+		return false;
 	}
 
 	void inline Write(uint64_t boardHash, short alpha, short beta, Move& bestmove, int searchEval, int boardEval, int depth, int ahead, int ttAge)
 	{
-		const uint32_t newChecksum = (uint32_t)(boardHash >> 32);
-		const bool sameBoard = (newChecksum == m_checksum);
+		// Build the new entry locally, then store it all at once
+		TEntry entry = Load();
+		const bool sameBoard = entry.IsBoard(boardHash);
 
-		m_checksum = newChecksum;
-		m_searchEval = searchEval;
-		m_boardEval = boardEval;
-		m_depth = depth;
+		entry.m_searchEval = searchEval;
+		entry.m_boardEval = boardEval;
+		entry.m_depth = depth;
 		if (!sameBoard || bestmove != NO_MOVE) // don't ovewrite a bestmove with no_move
 		{
-			m_bestmove = bestmove;
+			entry.m_bestmove = bestmove;
 		}
 
 		// If this is a game ending value, must adjust it since it depends on the variable ahead
-		if (m_searchEval > MIN_WIN_SCORE) m_searchEval += ahead;
-		if (m_searchEval < -MIN_WIN_SCORE) m_searchEval -= ahead;
-		assert(m_searchEval <= 2001);
-
-		m_ageAndFailtype = ttAge;
-		if (searchEval <= alpha) m_ageAndFailtype |= (TT_FAIL_LOW << 6);
-		else if (searchEval >= beta)  m_ageAndFailtype |= (TT_FAIL_HIGH << 6);
-		else m_ageAndFailtype |= (TT_EXACT << 6);
+		if (entry.m_searchEval > MIN_WIN_SCORE) entry.m_searchEval += ahead;
+		if (entry.m_searchEval < -MIN_WIN_SCORE) entry.m_searchEval -= ahead;
+		assert(entry.m_searchEval <= 2001);
+
+		entry.m_ageAndFailtype = ttAge;
+		if (searchEval <= alpha) entry.m_ageAndFailtype |= (TT_FAIL_LOW << 6);
+		else if (searchEval >= beta)  entry.m_ageAndFailtype |= (TT_FAIL_HIGH << 6);
+		else entry.m_ageAndFailtype |= (TT_EXACT << 6);
+
+		entry.m_checksum = HashChecksum(boardHash) ^ entry.DataKey();
+		memcpy(this, &entry, sizeof(TEntry));
 	}
 
-	// DATA
-	uint32_t m_checksum;
-	Move m_bestmove;
+	// Store the static eval for the board, if this entry is already for the board
+	void inline WriteBoardEval(uint64_t boardHash, int boardEval)
+	{
+		TEntry entry = Load();
+		if (entry.IsBoard(boardHash))
+		{
+			entry.m_boardEval = boardEval;
+			entry.m_checksum = HashChecksum(boardHash) ^ entry.DataKey();
+			memcpy(this, &entry, sizeof(TEntry));
+		}
+	}
+
+	// DATA (12 bytes)
+	uint16_t m_checksum;
 	int16_t m_searchEval;
+	Move m_bestmove;
 	int16_t m_boardEval;
 	int8_t m_depth;
 	uint8_t m_ageAndFailtype; // Age (6 bits) + FailType (2 bits)
 
-	inline uint8_t FailType() { return m_ageAndFailtype >> 6; }
-	inline uint8_t Age() { return (m_ageAndFailtype & 63); }
+	inline uint8_t FailType() const { return m_ageAndFailtype >> 6; }
+	inline uint8_t Age() const { return (m_ageAndFailtype & 63); }
 
-	int inline GetTestEval()
+	int inline GetTestEval() const
 	{
 		if (m_searchEval == INVALID_VAL) { return m_boardEval; }
 		bool preferSearchEval = (FailType() == TT_EXACT || (FailType() == TT_FAIL_HIGH && m_searchEval > m_boardEval) || (FailType() == TT_FAIL_LOW && m_searchEval < m_boardEval));
@@ -100,11 +153,13 @@ struct TEntry
 	}
 };
 
-// Buckets of entries. Choose which entry to overwrite, if they are all filled. Mainly helpful in case of ttable saturation.
-constexpr int ENTRIES_PER_BUCKET = 2;
-struct TBucket
+// Buckets of entries, sized and aligned to fill one 64 byte cache line. 
+// Choose which entry to overwrite, if they are all filled. Mainly helpful in case of ttable saturation.
+constexpr int ENTRIES_PER_BUCKET = 5;
+struct alignas(64) TBucket
 {
 	TEntry entries[ENTRIES_PER_BUCKET];
+	uint8_t padding[64 - ENTRIES_PER_BUCKET * sizeof(TEntry)];
 
 	// Choose which entry to write to
 	TEntry* ChooseEntry(uint64_t hashKey, uint8_t searchAge )
@@ -113,23 +168,26 @@ struct TBucket
 		TEntry* bestEntry = &entries[0];
 		for (int i = 0; i < ENTRIES_PER_BUCKET; i++)
 		{
-			int score;
+			const TEntry entry = entries[i].Load();
 
-			// If we find a match or empty entry, use it
-			if (entries[i].IsBoard(hashKey) || entries[i].m_checksum == 0)
+			// If we find a match use it. Keep looking at the whole line, since a match can come after an empty entry.
+			if (entry.IsBoard(hashKey))
 			{
-				bestEntry = &entries[i];
-				break;
+				return &entries[i];
+			}
+
+			// Otherwise use the first empty entry, or the best entry to replace based on depth, failtype and age
+			int score = 1000;
+			if (!entry.IsEmpty())
+			{
+				int ageDiff = searchAge - entry.Age();
+				if (ageDiff < 0)
+					ageDiff += 64;
+
+				score = -entry.m_depth;
+				score -= (entry.FailType() == TEntry::TT_EXACT) ? 10 : 0;
+				score += (ageDiff > 1) ? 100 : (ageDiff == 1) ? 4 : 0;
 			}
-			
-			// Otherwise use the best entry based on depth and failtype
-			int ageDiff = searchAge - entries[i].Age();
-			if (ageDiff < 0)
-				ageDiff += 64;
-
-			score = -entries[i].m_depth;
-			score -= (entries[i].FailType() == TEntry::TT_EXACT) ? 10 : 0;
-			score += (ageDiff > 1) ? 100 : (ageDiff == 1) ? 4 : 0;
 			if (score > bestScore)
 			{
 				bestScore = score;
@@ -139,6 +197,25 @@ struct TBucket
 		return bestEntry;
 	}
 };
+static_assert(sizeof(TBucket) == 64, "TBucket should fill exactly one cache line");
+
+// Header at the start of a mapped hash file. The buckets follow it, so it's 64 bytes to keep them cache line aligned.
+// The file is only reused if everything here matches what this build would write.
+constexpr uint32_t kTTFileVersion = 2; // bump when TEntry layout or DataKey changes
+struct TTFileHeader
+{
+	char magic[8];
+	uint32_t fileVersion;
+	uint32_t bucketBytes;
+	uint32_t entriesPerBucket;
+	uint32_t flags; // 1 = LOCKLESS_TT
+	uint64_t hashFunctionVersion;
+	uint64_t numBuckets;
+	int32_t sizeMb;
+	uint8_t ttAge;
+	uint8_t padding[19];
+};
+static_assert(sizeof(TTFileHeader) == 64, "TTFileHeader should keep the buckets cache line aligned");
 
 //
 // The Transposition table is made up of an array of TTEntries.
@@ -149,38 +226,65 @@ struct TranspositionTable
 	// transposition table data
 	TBucket* buckets = nullptr;
 	size_t numBuckets = 0;
-	int sizeMb = 128;
+	int sizeMb = 128; // the configured size, used for tables in memory and new hash files
+
+	// memory actually allocated, which can be rounded up to the page size
+	size_t allocBytes = 0;
+	size_t pageSize = 0;
+	bool bHugePagesRequested = false; // transparent huge pages, the OS may or may not give us the ones we asked for
+
+	// set when the table is mapped to a file instead of allocated
+	TTFileHeader* fileHeader = nullptr;
+	std::string filePath;
+	int fileSizeMb = 0; // size of the mapped table, a reloaded file keeps the size it was created with
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* fileMapping = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
 
 	static uint64_t HashFunction[NUM_BOARD_SQUARES][NUM_PIECE_TYPES];
 	static uint64_t HashSTM;
 
-	void Clear()
+	~TranspositionTable()
 	{
-		memset(buckets, 0, sizeof(TBucket) * numBuckets);
+		FreeTableMemory();
 	}
 
+	bool SetSizeMB(int _sizeMb);
+	void Clear();
+	std::string PageSizeString() const;
+
+	bool MapFile(const std::string& path, int _sizeMb, bool& bReloaded, std::string& error);
+	void FlushFile();
+	bool IsFileMapped() const { return fileHeader != nullptr; }
+	int TableSizeMb() const { return IsFileMapped() ? fileSizeMb : sizeMb; }
+
+	// Keep the search age in the file header current, so it's saved however the file is unmapped
+	void SetFileAge(uint8_t ttAge) { if (fileHeader != nullptr) { fileHeader->ttAge = ttAge; } }
+	static uint64_t HashFunctionVersion();
+
 	TEntry* GetEntry(const Board& board, uint8_t searchAge)
 	{
 		auto& bucket = buckets[board.hashKey % numBuckets];
 		return bucket.ChooseEntry(board.hashKey, searchAge);
 	}
 
-	// Allocate the hashtable.
-	// returns true if successful
-	bool SetSizeMB(int _sizeMb)
+	// Start loading the bucket for this hashKey into cache, so the memory access overlaps other work before GetEntry
+	inline void Prefetch(uint64_t hashKey) const
 	{
-		if (buckets)
-			AlignedFreeUtil(buckets);
-
-		sizeMb = _sizeMb;
-		numBuckets = ((size_t)sizeMb * (1 << 20)) / sizeof(TBucket);
-		buckets = AlignedAllocUtil<TBucket>(numBuckets, 64);
-		if (buckets != nullptr)
-			Clear();
-
-		return (buckets != nullptr);
+		_mm_prefetch((const char*)&buckets[hashKey % numBuckets], _MM_HINT_T0);
 	}
 
+	void* AllocTableMemory(size_t bytes);
+	void FreeTableMemory();
+	void* MapFileView(size_t bytes, bool bResize);
+	void UnmapFileView();
+	void UnmapFile();
+	void FillFileHeader();
+	bool IsFileHeaderValid(size_t fileBytes) const;
+
 	// FIXME? This probably isn't a good rand
 	static uint64_t Rand15() { return (uint64_t)rand(); }
 	static uint64_t Rand64() {